@@ -23,18 +23,24 @@ class BM:
         win = self.SADWindowSize // 2
         shape = self.left_image.get_shape()
         disp = tf.get_variable('disp', [shape[0] - 1, shape[1] - 1, 1], tf.int32, tf.zeros_initializer)
+        conf = tf.get_variable('conf', [shape[0] - 1, shape[1] - 1, 1], tf.int32, tf.zeros_initializer)
         for i in range(0, shape[0] - 1 - self.SADWindowSize):
             for j in range(0, shape[1] - 1 - self.SADWindowSize - self.numberOfDisparities):
-                bestMatchSoFar = self.coMatch(i, j)
+                bestMatchSoFar, confidence = self.coMatch(i, j)
                 indices = tf.constant([[(i + win) * self.image_height + (j + win)]])
-                updates = tf.constant([bestMatchSoFar])
                 disp_shape = tf.constant([self.image_height * self.image_width])
+                updates = tf.constant([bestMatchSoFar])
                 scatter = tf.reshape(tf.scatter_nd(indices, updates, disp_shape), [shape[0], shape[1], shape[2]])
                 disp = tf.add(disp, scatter)
-        return disp
+                updates = tf.constant([confidence])
+                scatter = tf.reshape(tf.scatter_nd(indices, updates, disp_shape), [shape[0], shape[1], shape[2]])
+                conf = tf.add(conf, scatter)
+        return disp, conf
 
     def coMatch(self, i, j):
+        """Returns the disparity at (i, j) and its 8-bit confidence."""
         prevSad_1 = 4294967295
+        secondSad_1 = 4294967295
         prevSad_2 = 4294967295
         bestMatchSoFar = self.minDisparity
         bestMatchSoFar_1 = self.minDisparity
@@ -46,8 +52,11 @@ class BM:
                                                         self.SADWindowSize, self.SADWindowSize)
             sad = tf.reduce_sum(tf.abs(tf.subtract(block_left, block_right)))
             if prevSad_1 > sad:
+                secondSad_1 = prevSad_1
                 prevSad_1 = sad
                 bestMatchSoFar_1 = dispRange
+            elif secondSad_1 > sad:
+                secondSad_1 = sad
         for dispRange in range(self.minDisparity, self.numberOfDisparities):
             block_left = tf.image.crop_to_bounding_box(self.right_image, i, j + bestMatchSoFar_1,
                                                        self.SADWindowSize, self.SADWindowSize)
@@ -57,7 +66,25 @@ class BM:
             if prevSad_2 > sad:
                 prevSad_2 = sad
                 bestMatchSoFar_2 = dispRange
-        if np.abs(bestMatchSoFar_1, bestMatchSoFar_2) < self.disp12MaxDiff:
+        lrCheck = np.abs(bestMatchSoFar_1 - bestMatchSoFar_2) < self.disp12MaxDiff
+        if lrCheck:
             bestMatchSoFar = bestMatchSoFar_1
-        return bestMatchSoFar
+        block_left = tf.image.crop_to_bounding_box(self.left_image, i, j,
+                                                   self.SADWindowSize, self.SADWindowSize)
+        texture = tf.reduce_sum(tf.abs(tf.subtract(block_left[:, 1:], block_left[:, :-1])))
+        return bestMatchSoFar, self.confidence(prevSad_1, secondSad_1, texture, lrCheck)
+
+    def confidence(self, bestSad, secondSad, texture, lrCheck):
+        """
+        Maps the costs coMatch already has to 0-255: the uniqueness margin of
+        the best over the second best cost, scaled so uniquenessRatio gives
+        128, times the texture strength relative to textureThreshold. Pixels
+        failing the left-right check get 0.
+        """
+        if not lrCheck:
+            return 0
+        margin = (secondSad - bestSad) * 100.0 / max(bestSad, 1)
+        uniqueness = min(1.0, margin / (2.0 * max(self.uniquenessRatio, 1)))
+        strength = min(1.0, texture / (2.0 * max(self.textureThreshold, 1)))
+        return int(255 * uniqueness * strength)
 
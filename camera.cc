@@ -41,6 +41,10 @@ void Camera::GetResolutions(const std::int32_t &dev_index,
     d_ptr->GetResolutions(dev_index, color_infos, depth_infos);
 }
 
+void Camera::SetDeviceCachePath(const std::string &path) {
+    d_ptr->SetDeviceCachePath(path);
+}
+
 ErrorCode Camera::Open() {
     std::vector<DeviceInfo> dev_infos = GetDevices();
     if (dev_infos.size() <= 0) {
@@ -54,6 +58,14 @@ ErrorCode Camera::Open(const InitParams &params) {
     return d_ptr->Open(params);
 }
 
+void Camera::OpenAsync(const InitParams &params, OpenCallback callback) {
+    d_ptr->OpenAsync(params, std::move(callback));
+}
+
+std::future<ErrorCode> Camera::OpenAsync(const InitParams &params) {
+    return d_ptr->OpenAsync(params);
+}
+
 bool Camera::IsOpened() {
     return d_ptr->IsOpened();
 }
@@ -66,6 +78,51 @@ ushort Camera::GetMinDepth() {
 	return d_ptr->GetMinDepth();
 }
 
+ErrorCode Camera::RetrieveDepthImage(cv::Mat &depth) {
+    return d_ptr->RetrieveDepthImage(depth);
+}
+
+ErrorCode Camera::RetrieveDepthImage(cv::Mat &depth, cv::Mat &confidence,
+        const DepthConfidenceParams &params) {
+    return d_ptr->RetrieveDepthImage(depth, confidence, params);
+}
+
+void Camera::NextFrameAsync(DepthFrameCallback callback) {
+    d_ptr->NextFrameAsync(std::move(callback));
+}
+
+std::future<ErrorCode> Camera::NextFrameAsync(cv::Mat &depth) {
+    return d_ptr->NextFrameAsync(depth);
+}
+
+ErrorCode Camera::EnableDepthPublisher(const std::string &name, std::int32_t slot_count) {
+    return d_ptr->EnableDepthPublisher(name, slot_count);
+}
+
+void Camera::DisableDepthPublisher() {
+    d_ptr->DisableDepthPublisher();
+}
+
+ErrorCode Camera::EnableExposureControl(const ExposureControlParams &params) {
+    return d_ptr->EnableExposureControl(params);
+}
+
+void Camera::DisableExposureControl() {
+    d_ptr->DisableExposureControl();
+}
+
+void Camera::ReadRegisters(std::vector<RegisterOp> &ops) {
+    d_ptr->ReadRegisters(ops);
+}
+
+void Camera::WriteRegisters(std::vector<RegisterOp> &ops) {
+    d_ptr->WriteRegisters(ops);
+}
+
+StartupTimings Camera::GetStartupTimings() {
+    return d_ptr->GetStartupTimings();
+}
+
 void Camera::Close() {
     d_ptr->Close();
 }
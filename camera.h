@@ -16,14 +16,21 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
 
+#include "depth_confidence.h"
 #include "dev_info.h"
+#include "exposure_control.h"
 #include "init_params.h"
 #include "mynteye.h"
+#include "register_op.h"
+#include "startup_timings.h"
 #include "stream_info.h"
 
 namespace mynteye {
@@ -40,14 +47,96 @@ public:
     void GetResolutions(const std::int32_t &dev_index,
         std::vector<StreamInfo> &color_infos, std::vector<StreamInfo> &depth_infos);
 
+    /**
+     * Persists firmware version and resolution lists per serial number in
+     * path, so later runs skip those queries. Empty keeps them in memory.
+     */
+    void SetDeviceCachePath(const std::string &path);
+
     ErrorCode Open();
     ErrorCode Open(const InitParams &params);
 
+    typedef std::function<void(ErrorCode)> OpenCallback;
+
+    /**
+     * Runs Open on a worker thread and calls callback there once it
+     * returns. IsOpened stays false until the device streams. Fails at once
+     * with ERROR_CAMERA_OPEN_FAILED while another open is in progress.
+     * Close meanwhile does not wait, the open then ends with
+     * ERROR_CAMERA_NOT_OPENED and the device closed. The destructor waits
+     * for Open to return but not for callback, which may destroy the camera.
+     * Throws std::system_error, with nothing started, if no thread can be
+     * created.
+     */
+    void OpenAsync(const InitParams &params, OpenCallback callback);
+    /** Future variant, ready once Open returns. */
+    std::future<ErrorCode> OpenAsync(const InitParams &params);
+
     bool IsOpened();
 
     ErrorCode RetrieveDepth();
 	ushort GetMinDepth();
 
+    /** Copies the latest depth frame into a CV_16UC1 mat. */
+    ErrorCode RetrieveDepthImage(cv::Mat &depth);
+    /**
+     * Also fills a CV_8UC1 confidence map of the frame, 0 for invalid
+     * pixels up to 255. A neighbour agreement proxy computed from the copy
+     * in a separate pass, see ComputeDepthConfidence.
+     */
+    ErrorCode RetrieveDepthImage(cv::Mat &depth, cv::Mat &confidence,
+        const DepthConfidenceParams &params = DepthConfidenceParams());
+
+    typedef std::function<void(ErrorCode, const cv::Mat &)> DepthFrameCallback;
+
+    /**
+     * Calls callback once with the next depth frame (CV_16UC1), on the SDK
+     * callback thread and without the frame lock held. The frame is a view
+     * of a buffer reused for the next one, clone it to keep it. Close
+     * completes pending callbacks with ERROR_CAMERA_NOT_OPENED, and waits
+     * for callbacks being called. A callback may Close the camera, but not
+     * Open or destroy it. Call after Open.
+     */
+    void NextFrameAsync(DepthFrameCallback callback);
+    /**
+     * Future variant, depth is sized here and filled before the future is
+     * ready, and must outlive it. The future allocates on this thread.
+     */
+    std::future<ErrorCode> NextFrameAsync(cv::Mat &depth);
+
+    /**
+     * Publishes every depth frame into shared memory under name, for
+     * DepthSubscriber in other processes. Call after Open.
+     */
+    ErrorCode EnableDepthPublisher(const std::string &name, std::int32_t slot_count = 4);
+    void DisableDepthPublisher();
+
+    /**
+     * Adjusts IR intensity and exposure from the depth fill rate of every
+     * frame the device delivers, whether or not it is retrieved. Register
+     * writes happen on the image callback thread. Call after Open.
+     */
+    ErrorCode EnableExposureControl(const ExposureControlParams &params);
+    void DisableExposureControl();
+
+    /**
+     * Runs a batch of reads, duplicates are read once. Values read refresh
+     * what WriteRegisters knows the registers hold. Call after Open.
+     */
+    void ReadRegisters(std::vector<RegisterOp> &ops);
+    /**
+     * Runs a batch of writes, the last write to a register wins and values
+     * the register is known to hold already are skipped. Call after Open.
+     *
+     * The device changes sensor exposure and gain registers on its own while
+     * auto-exposure is on, so a skipped write to one of those may leave a
+     * different value in place. Disable auto-exposure first, or read the
+     * register back right before writing it.
+     */
+    void WriteRegisters(std::vector<RegisterOp> &ops);
+
+    StartupTimings GetStartupTimings();
+
     void Close();
 
 private:
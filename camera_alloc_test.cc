@@ -0,0 +1,302 @@
+#include "eSPDI.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "camera.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: camera_alloc_test
+//
+// Opens a Camera over a fake eSPDI, defined below in place of the vendor
+// library, then drives the image callback with exposure control on,
+// NextFrameAsync waiters and RetrieveDepth for many frames while counting
+// every operator new and, on glibc, malloc. Fails on any allocation once
+// warmed up, or if control writes are not min_interval_frames delivered
+// frames apart while RetrieveDepth polls at a different rate. Opens with
+// default InitParams, so whether Open writes IR intensity is up to them.
+// Then reopens and closes from a waiter, which must leave the frame the
+// waiters see intact; build with -fsanitize=address to have that checked.
+//
+// Build on Linux with glibc, which the malloc hooks need, with the eSPDI
+// and SDK headers but without the eSPDI library:
+//
+//   g++ -std=c++11 -I<sdk include paths> -o camera_alloc_test camera_alloc_test.cc
+//       camera.cc camera_p.cc device_cache.cc depth_confidence.cc depth_shm.cc
+//       exposure_control.cc memory_profile.cc simd.cc simd_sse2.cc simd_neon.cc
+//       -lpthread -lrt
+
+namespace {
+
+const int kWidth = 640;
+const int kHeight = 480;
+const int kWarmupFrames = 10;
+const int kFrames = 600;
+const int kMinIntervalFrames = 5;
+// RetrieveDepth runs on every kPollInterval-th frame only.
+const int kPollInterval = 3;
+const unsigned short kExposureAddress = 0x3012;
+const int kMaxWrites = 256;
+
+atomic<bool> counting(false);
+atomic<long> allocations(0);
+
+void CountAllocation() {
+    if (counting) allocations++;
+}
+
+struct FakeDevice {
+    EtronDI_ImgCallbackFn callback = nullptr;
+    void *param = nullptr;
+    unsigned short ir = 0;
+    unsigned short exposure = 0;
+    /** IR and exposure writes, and the frame each was made on. */
+    int writes = 0;
+    int write_frames[kMaxWrites];
+    /** Index of the frame being delivered. */
+    int frame = 0;
+
+    void CountWrite() {
+        if (writes < kMaxWrites) write_frames[writes] = frame;
+        writes++;
+    }
+} device;
+
+/** 20% of pixels at 3 m, the rest invalid, so exposure control steps up. */
+vector<unsigned char> MakeFrame() {
+    vector<unsigned char> frame(kWidth * kHeight * 2, 0);
+    for (int i = 0; i < kWidth * kHeight; i++) {
+        if (i % 5) continue;
+        frame[i * 2] = 3000 & 0xFF;
+        frame[i * 2 + 1] = 3000 >> 8;
+    }
+    return frame;
+}
+
+}  // namespace
+
+void *operator new(size_t size) {
+    CountAllocation();
+    void *p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const nothrow_t &) noexcept {
+    CountAllocation();
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const nothrow_t &) noexcept {
+    return operator new(size, nothrow);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+#if defined(__GLIBC__)
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+
+void *malloc(size_t size) __THROW {
+    CountAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) __THROW {
+    CountAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *p, size_t size) __THROW {
+    CountAllocation();
+    return __libc_realloc(p, size);
+}
+
+}  // extern "C"
+#endif
+
+// The fake eSPDI, one device streaming kWidth x kHeight depth.
+
+int EtronDI_Init(void **handle, bool) {
+    *handle = &device;
+    return 1;
+}
+
+void EtronDI_Release(void **handle) {
+    *handle = nullptr;
+}
+
+int EtronDI_GetDeviceNumber(void *) {
+    return 1;
+}
+
+int EtronDI_GetDeviceInfo(void *, PDEVSELINFO, DEVINFORMATION *info) {
+    memset(info, 0, sizeof(*info));
+    strcpy(info->strDevName, "fake");
+    return ETronDI_OK;
+}
+
+int EtronDI_GetFwVersion(void *, PDEVSELINFO, char *buf, int size, int *length) {
+    *length = snprintf(buf, size, "fake");
+    return ETronDI_OK;
+}
+
+int EtronDI_GetSerialNumber(void *, PDEVSELINFO, BYTE *, int, int *) {
+    return -1;
+}
+
+int EtronDI_GetDeviceResolutionList(void *, PDEVSELINFO, int, PETRONDI_STREAM_INFO color,
+        int, PETRONDI_STREAM_INFO depth) {
+    color[0].nWidth = depth[0].nWidth = kWidth;
+    color[0].nHeight = depth[0].nHeight = kHeight;
+    return ETronDI_OK;
+}
+
+int EtronDI_EnableAE(void *, PDEVSELINFO) { return ETronDI_OK; }
+int EtronDI_DisableAE(void *, PDEVSELINFO) { return ETronDI_OK; }
+int EtronDI_EnableAWB(void *, PDEVSELINFO) { return ETronDI_OK; }
+int EtronDI_DisableAWB(void *, PDEVSELINFO) { return ETronDI_OK; }
+int EtronDI_SetDepthDataType(void *, PDEVSELINFO, int) { return ETronDI_OK; }
+
+int EtronDI_OpenDeviceEx(void *, PDEVSELINFO, int, bool, int, int,
+        EtronDI_ImgCallbackFn callback, void *param, int *, BYTE) {
+    device.callback = callback;
+    device.param = param;
+    return ETronDI_OK;
+}
+
+int EtronDI_CloseDevice(void *, PDEVSELINFO) {
+    device.callback = nullptr;
+    return ETronDI_OK;
+}
+
+int EtronDI_GetSensorRegister(void *, PDEVSELINFO, int, unsigned short address, unsigned short *value,
+        int, int) {
+    *value = address == kExposureAddress ? device.exposure : 0;
+    return ETronDI_OK;
+}
+
+int EtronDI_SetSensorRegister(void *, PDEVSELINFO, int, unsigned short address, unsigned short value,
+        int, int) {
+    if (address == kExposureAddress) {
+        device.exposure = value;
+        device.CountWrite();
+    }
+    return ETronDI_OK;
+}
+
+int EtronDI_GetHWRegister(void *, PDEVSELINFO, unsigned short, unsigned short *value, int) {
+    *value = 0;
+    return ETronDI_OK;
+}
+
+int EtronDI_SetHWRegister(void *, PDEVSELINFO, unsigned short, unsigned short, int) {
+    return ETronDI_OK;
+}
+
+int EtronDI_GetFWRegister(void *, PDEVSELINFO, unsigned short address, unsigned short *value, int) {
+    *value = address == 0xE0 ? device.ir : 0;
+    return ETronDI_OK;
+}
+
+int EtronDI_SetFWRegister(void *, PDEVSELINFO, unsigned short address, unsigned short value, int) {
+    if (address == 0xE0) {
+        device.ir = value;
+        device.CountWrite();
+    }
+    return ETronDI_OK;
+}
+
+int main(int argc, char const *argv[]) {
+    vector<unsigned char> frame = MakeFrame();
+
+    Camera camera;
+    InitParams params(0);
+    if (camera.Open(params) != ErrorCode::SUCCESS || !device.callback) {
+        cerr << "Error: Open failed" << endl;
+        return 1;
+    }
+    ExposureControlParams control;
+    control.min_interval_frames = kMinIntervalFrames;
+    control.exposure_address = kExposureAddress;
+    camera.EnableExposureControl(control);
+    // Only the writes of the control loop, not the one Open may have made.
+    device.writes = 0;
+
+    long delivered = 0, retrieved = 0;
+    // Captures one pointer, so std::function keeps it without allocating.
+    Camera::DepthFrameCallback waiter = [&delivered](ErrorCode code, const cv::Mat &depth) {
+        if (code == ErrorCode::SUCCESS && !depth.empty()) delivered++;
+    };
+
+    long steady_writes = 0;
+    for (int i = 0; i < kWarmupFrames + kFrames; i++) {
+        if (i == kWarmupFrames) {
+            steady_writes = -device.writes;
+            counting = true;
+        }
+        camera.NextFrameAsync(waiter);
+        device.frame = i;
+        device.callback(EtronDIImageType::DEPTH, i, frame.data(), int(frame.size()),
+            kWidth, kHeight, 0, device.param);
+        if (i % kPollInterval == 0 && camera.RetrieveDepth() == ErrorCode::SUCCESS &&
+                camera.GetMinDepth() == 3000) {
+            retrieved++;
+        }
+    }
+    counting = false;
+    steady_writes += device.writes;
+    camera.Close();
+
+    bool interval_ok = device.writes > 1;
+    for (int i = 1; interval_ok && i < min(device.writes, kMaxWrites); i++) {
+        interval_ok = device.write_frames[i] - device.write_frames[i - 1] == kMinIntervalFrames;
+    }
+
+    long frames = kWarmupFrames + kFrames;
+    long polls = (frames + kPollInterval - 1) / kPollInterval;
+    cout << "Frames                    : " << frames << endl;
+    cout << "Waiters called            : " << delivered << endl;
+    cout << "RetrieveDepth ok          : " << retrieved << endl;
+    cout << "Writes after warm-up      : " << steady_writes << endl;
+    cout << "Write interval            : " << (interval_ok ? "ok" : "FAILED") << endl;
+    cout << "Allocations after warm-up : " << allocations << endl;
+
+    // Close from a waiter, the ones after it still read the frame.
+    bool close_ok = camera.Open(params) == ErrorCode::SUCCESS && device.callback;
+    if (close_ok) {
+        EtronDI_ImgCallbackFn callback = device.callback;
+        int after_close = -1;
+        camera.NextFrameAsync([&camera](ErrorCode, const cv::Mat &) { camera.Close(); });
+        camera.NextFrameAsync([&after_close](ErrorCode code, const cv::Mat &depth) {
+            if (code == ErrorCode::SUCCESS) after_close = depth.at<uint16_t>(0, 0);
+        });
+        callback(EtronDIImageType::DEPTH, 0, frame.data(), int(frame.size()), kWidth, kHeight,
+            0, device.param);
+        close_ok = !camera.IsOpened() && after_close == 3000;
+    }
+    cout << "Close from a waiter       : " << (close_ok ? "ok" : "FAILED") << endl;
+
+    bool ok = delivered == frames && retrieved == polls && steady_writes > 0 && interval_ok &&
+        allocations == 0 && close_ok;
+    cout << (ok ? "ok" : "FAILED") << endl;
+    return ok ? 0 : 1;
+}
@@ -13,20 +13,66 @@
 // limitations under the License.
 #include "camera_p.h"
 
+#include <cctype>
+#include <chrono>
+#include <exception>
 #include <stdexcept>
+#include <thread>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "log.hpp"
+#include "simd.h"
 
 
 
 using namespace mynteye;
 
+namespace {
 
+class CameraRegisterBackend : public RegisterBackend {
+public:
+	explicit CameraRegisterBackend(CameraPrivate *p) : p_(p) {}
+
+	bool GetSensorRegister(int id, unsigned short address, unsigned short *value) override {
+		return p_->GetSensorRegister(id, address, value);
+	}
+
+	bool SetSensorRegister(int id, unsigned short address, unsigned short value) override {
+		return p_->SetSensorRegister(id, address, value);
+	}
+
+	bool SetFWRegister(unsigned short address, unsigned short value) override {
+		return p_->SetFWRegister(address, value);
+	}
+
+private:
+	CameraPrivate *p_;
+};
+
+typedef std::chrono::steady_clock startup_clock;
+
+/** NextFrameAsync waiters per frame that do not grow the lists. */
+const std::size_t kFrameCallbackReserve = 16;
+
+/** Milliseconds since t, then restarts t. */
+double Lap(startup_clock::time_point &t) {
+	startup_clock::time_point now = startup_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(now - t).count();
+	t = now;
+	return ms;
+}
+
+inline std::uint64_t RegisterKey(RegisterType type, int id, unsigned short address) {
+	if (type != RegisterType::SENSOR) id = 0;
+	return (std::uint64_t(type) << 48) | (std::uint64_t(std::uint32_t(id)) << 16) | address;
+}
+
+}  // namespace
 
 CameraPrivate::CameraPrivate(Camera *q)
-	: q_ptr(q), etron_di_(nullptr), dev_sel_info_({ -1 }), stream_info_dev_index_(-1) {
+	: q_ptr(q), etron_di_(nullptr), dev_sel_info_({ -1 }), stream_info_dev_index_(-1),
+	ir_intensity_(-1), register_backend_(new CameraRegisterBackend(this)) {
 	DBG_LOGD(__func__);
 
 	/*! \fn int EtronDI_Init(
@@ -42,56 +88,97 @@ CameraPrivate::CameraPrivate(Camera *q)
 	DBG_LOGI("EtronDI_Init: %d", ret);
 	unused(ret);
 
+#ifdef MYNTEYE_EMBEDDED
+	stream_color_info_ptr_ = stream_color_infos_;
+	stream_depth_info_ptr_ = stream_depth_infos_;
+#else
 	stream_color_info_ptr_ = (PETRONDI_STREAM_INFO)malloc(sizeof(ETRONDI_STREAM_INFO) * 64);
 	stream_depth_info_ptr_ = (PETRONDI_STREAM_INFO)malloc(sizeof(ETRONDI_STREAM_INFO) * 64);
+#endif
 	color_res_index_ = 0;
 	depth_res_index_ = 0;
 
 	framerate_ = 30;
 
 	depth_img_buf_ = nullptr;
+	depth_ready_ = false;
+	callback_frame_ = nullptr;
+	in_frame_callback_ = false;
+	orphan_frame_ = nullptr;
+
+	opening_ = false;
+	opened_ = false;
+	close_requested_ = false;
+	open_workers_ = 0;
 }
 
 CameraPrivate::~CameraPrivate() {
     DBG_LOGD(__func__);
+    {
+        std::unique_lock<std::mutex> lock(mtx_open_);
+        cv_open_.wait(lock, [this]() { return open_workers_ == 0; });
+    }
     EtronDI_Release(&etron_di_);
 
+#ifndef MYNTEYE_EMBEDDED
     free(stream_color_info_ptr_);
     free(stream_depth_info_ptr_);
+#endif
 
     Close();
 }
 
 void CameraPrivate::GetDevices(std::vector<DeviceInfo> &dev_infos) {
+	startup_clock::time_point t = startup_clock::now();
 	dev_infos.clear();
 
 	int count = EtronDI_GetDeviceNumber(etron_di_);
 	DBG_LOGD("EtronDI_GetDeviceNumber: %d", count);
 
 	DEVSELINFO dev_sel_info;
-	DEVINFORMATION *p_dev_info = (DEVINFORMATION*)malloc(sizeof(DEVINFORMATION)*count);
+	DEVINFORMATION dev_info;
 
 	for (int i = 0; i < count; i++) {
 		dev_sel_info.index = i;
 
-		EtronDI_GetDeviceInfo(etron_di_, &dev_sel_info, p_dev_info + i);
+		EtronDI_GetDeviceInfo(etron_di_, &dev_sel_info, &dev_info);
+
+		// Known devices are found by their enumeration path, so listing them
+		// takes no round trip to the device. Open checks the serial number.
+		std::string device_path = dev_info.strDevName;
+		DeviceDescriptor *desc = device_cache_.FindByDevicePath(device_path);
+		std::string fw_version;
+		if (desc && !desc->fw_version.empty()) {
+			fw_version = desc->fw_version;
+		}
+		else {
+			char sz_buf[256];
+			int actual_length = 0;
+			if (ETronDI_OK == EtronDI_GetFwVersion(etron_di_, &dev_sel_info, sz_buf, 256, &actual_length)) {
+				fw_version = sz_buf;
+				std::string serial_number = GetSerialNumber(i);
+				if (!serial_number.empty()) {
+					device_cache_.Bind(serial_number, device_path).fw_version = fw_version;
+				}
+			}
+		}
 
-		char sz_buf[256];
-		int actual_length = 0;
-		if (ETronDI_OK == EtronDI_GetFwVersion(etron_di_, &dev_sel_info, sz_buf, 256, &actual_length)) {
+		if (!fw_version.empty()) {
 			DeviceInfo info;
 			info.index = i;
-			info.name = p_dev_info[i].strDevName;
-			info.type = p_dev_info[i].nDevType;
-			info.pid = p_dev_info[i].wPID;
-			info.vid = p_dev_info[i].wVID;
-			info.chip_id = p_dev_info[i].nChipID;
-			info.fw_version = sz_buf;
+			info.name = dev_info.strDevName;
+			info.type = dev_info.nDevType;
+			info.pid = dev_info.wPID;
+			info.vid = dev_info.wVID;
+			info.chip_id = dev_info.nChipID;
+			info.fw_version = fw_version;
 			dev_infos.push_back(std::move(info));
 		}
 	}
 
-	free(p_dev_info);
+	device_cache_.Save();
+	std::lock_guard<std::mutex> _(mtx_timings_);
+	startup_timings_.get_devices = Lap(t);
 }
 
 void CameraPrivate::GetResolutions(const std::int32_t &dev_index,
@@ -99,11 +186,7 @@ void CameraPrivate::GetResolutions(const std::int32_t &dev_index,
 	color_infos.clear();
 	depth_infos.clear();
 
-	memset(stream_color_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO) * 64);
-	memset(stream_depth_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO) * 64);
-
-	DEVSELINFO dev_sel_info{ dev_index };
-	EtronDI_GetDeviceResolutionList(etron_di_, &dev_sel_info, 64, stream_color_info_ptr_, 64, stream_depth_info_ptr_);
+	LoadResolutions(dev_index);
 
 	PETRONDI_STREAM_INFO stream_temp_info_ptr = stream_color_info_ptr_;
 	int i = 0;
@@ -134,8 +217,61 @@ void CameraPrivate::GetResolutions(const std::int32_t &dev_index,
 		stream_temp_info_ptr++;
 		i++;
 	}
+}
+
+void CameraPrivate::LoadResolutions(std::int32_t dev_index) {
+	// Asked from the device itself: after hotplug another device may have
+	// taken this index or the path GetDevices knew it by.
+	std::string serial_number = GetSerialNumber(dev_index);
+	if (dev_index == stream_info_dev_index_ && serial_number == stream_info_serial_) return;
+	DeviceDescriptor *desc = serial_number.empty() ? nullptr : device_cache_.Find(serial_number);
+	if (desc && desc->color_infos.size() == 64 && desc->depth_infos.size() == 64) {
+		memcpy(stream_color_info_ptr_, desc->color_infos.data(), sizeof(ETRONDI_STREAM_INFO) * 64);
+		memcpy(stream_depth_info_ptr_, desc->depth_infos.data(), sizeof(ETRONDI_STREAM_INFO) * 64);
+	}
+	else {
+		memset(stream_color_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO) * 64);
+		memset(stream_depth_info_ptr_, 0, sizeof(ETRONDI_STREAM_INFO) * 64);
+
+		DEVSELINFO dev_sel_info{ dev_index };
+		EtronDI_GetDeviceResolutionList(etron_di_, &dev_sel_info, 64, stream_color_info_ptr_, 64, stream_depth_info_ptr_);
+
+		if (!serial_number.empty()) {
+			DeviceDescriptor &cached = device_cache_.Get(serial_number);
+			cached.color_infos.assign(stream_color_info_ptr_, stream_color_info_ptr_ + 64);
+			cached.depth_infos.assign(stream_depth_info_ptr_, stream_depth_info_ptr_ + 64);
+		}
+	}
+	if (!serial_number.empty()) {
+		DEVSELINFO dev_sel_info{ dev_index };
+		DEVINFORMATION dev_info;
+		if (ETronDI_OK == EtronDI_GetDeviceInfo(etron_di_, &dev_sel_info, &dev_info)) {
+			device_cache_.Bind(serial_number, dev_info.strDevName);
+		}
+		device_cache_.Save();
+	}
 
 	stream_info_dev_index_ = dev_index;
+	stream_info_serial_ = serial_number;
+}
+
+void CameraPrivate::SetDeviceCachePath(const std::string &path) {
+	device_cache_.SetPath(path);
+}
+
+std::string CameraPrivate::GetSerialNumber(std::int32_t dev_index) {
+	DEVSELINFO dev_sel_info{ dev_index };
+	BYTE sz_buf[256];
+	int actual_length = 0;
+	if (ETronDI_OK != EtronDI_GetSerialNumber(etron_di_, &dev_sel_info, sz_buf, 256, &actual_length)) {
+		return std::string();
+	}
+	// Reported as UTF-16, keep the ASCII alphanumerics as the cache key.
+	std::string serial_number;
+	for (int i = 0; i < actual_length && i < 256; i++) {
+		if (std::isalnum(sz_buf[i])) serial_number += char(sz_buf[i]);
+	}
+	return serial_number;
 }
 
 ErrorCode CameraPrivate::SetAutoExposureEnabled(bool enabled) {
@@ -173,24 +309,47 @@ ErrorCode CameraPrivate::SetAutoWhiteBalanceEnabled(bool enabled) {
 }
 
 ErrorCode CameraPrivate::Open(const InitParams &params) {
+	if (!BeginOpen()) return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+	ErrorCode code;
+	try {
+		code = OpenDevice(params);
+	}
+	catch (...) {
+		EndOpen(ErrorCode::ERROR_CAMERA_OPEN_FAILED);
+		throw;
+	}
+	return EndOpen(code);
+}
+
+ErrorCode CameraPrivate::OpenDevice(const InitParams &params) {
+	startup_clock::time_point start = startup_clock::now();
+	startup_clock::time_point t = start;
+	// Filled locally and published at the end, GetStartupTimings may run
+	// on another thread meanwhile.
+	StartupTimings timings;
+	ClearRegisterShadow();
+	// IR intensity, which exposure control writes from the frame callback.
+	ReserveRegisterShadow(RegisterType::FW, 0, 0xE0);
+
 	dev_sel_info_.index = params.dev_index;
 	depth_data_type_ = 2;
 	EtronDI_SetDepthDataType(etron_di_, &dev_sel_info_, depth_data_type_);
 	DBG_LOGI("EtronDI_SetDepthDataType: %d", depth_data_type_);
+	timings.depth_data_type = Lap(t);
 
 	SetAutoExposureEnabled(params.state_ae);
+	timings.auto_exposure = Lap(t);
 	SetAutoWhiteBalanceEnabled(params.state_awb);
+	timings.auto_white_balance = Lap(t);
 
 	if (params.framerate > 0) framerate_ = params.framerate;
 	LOGI("-- Framerate: %d", framerate_);
 
 	depth_mode_ = params.depth_mode;
 
-	if (params.dev_index != stream_info_dev_index_) {
-		std::vector<StreamInfo> color_infos;
-		std::vector<StreamInfo> depth_infos;
-		GetResolutions(params.dev_index, color_infos, depth_infos);
-	}
+	// Only a serial number query when the same device is loaded already.
+	LoadResolutions(params.dev_index);
+	timings.get_resolutions = Lap(t);
 	if (params.color_info_index > -1) {
 		color_res_index_ = params.color_info_index;
 	}
@@ -210,16 +369,28 @@ ErrorCode CameraPrivate::Open(const InitParams &params) {
 		throw std::runtime_error(format_string("Error: Depth data type (%d) not supported.", depth_data_type_));
 	}
 
+	ir_intensity_ = -1;
+	std::vector<RegisterOp> register_ops;
 	if (params.ir_intensity >= 0) {
-		if (SetFWRegister(0xE0, params.ir_intensity)) {
+		register_ops.emplace_back(RegisterType::FW, 0xE0, (unsigned short)params.ir_intensity);
+	}
+	WriteRegisters(register_ops);
+	if (params.ir_intensity >= 0) {
+		if (register_ops[0].ok) {
+			ir_intensity_ = params.ir_intensity;
 			LOGI("-- IR intensity: %d", params.ir_intensity);
 		}
 		else {
 			LOGI("-- IR intensity: %d (failed)", params.ir_intensity);
 		}
 	}
+	timings.registers = Lap(t);
 
 	ReleaseBuf();
+	if (!AllocateBuf()) {
+		dev_sel_info_.index = -1;  // reset flag
+		return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+	}
 
 	// int EtronDI_OpenDeviceEx(
 	//     void* pHandleEtronDI,
@@ -248,40 +419,179 @@ ErrorCode CameraPrivate::Open(const InitParams &params) {
 		color_res_index_, toRgb,
 		depth_res_index_, depthStreamSwitch,
 		CameraPrivate::ImgCallback, this, &framerate_, ctrlMode);
+	timings.open_device = Lap(t);
+	timings.open_total = Lap(start);
+	{
+		std::lock_guard<std::mutex> _(mtx_timings_);
+		timings.get_devices = startup_timings_.get_devices;
+		startup_timings_ = timings;
+	}
+	LOGI("-- Startup: devices %.1f ms, resolutions %.1f ms, depth type %.1f ms, AE %.1f ms, "
+		"AWB %.1f ms, registers %.1f ms, open %.1f ms, total %.1f ms",
+		timings.get_devices, timings.get_resolutions,
+		timings.depth_data_type, timings.auto_exposure,
+		timings.auto_white_balance, timings.registers,
+		timings.open_device, timings.open_total);
 
 	if (ret == ETronDI_OK) {
+		opened_ = true;
 		return ErrorCode::SUCCESS;
 	}
 	else {
 		dev_sel_info_.index = -1;  // reset flag
+		CancelFrameCallbacks(ErrorCode::ERROR_CAMERA_NOT_OPENED);
 		return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
 	}
 }
 
+void CameraPrivate::OpenAsync(const InitParams &params, Camera::OpenCallback callback) {
+	if (!BeginOpen()) {
+		if (callback) callback(ErrorCode::ERROR_CAMERA_OPEN_FAILED);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> _(mtx_open_);
+		open_workers_++;
+	}
+	// Detached, so no caller blocks on it. The destructor waits for
+	// open_workers_ instead of joining.
+	try {
+		std::thread([this, params, callback]() {
+			ErrorCode code = ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+			try {
+				code = OpenDevice(params);
+			}
+			catch (const std::exception &e) {
+				LOGE("%s", e.what());
+			}
+			code = EndOpen(code);
+			{
+				std::lock_guard<std::mutex> _(mtx_open_);
+				open_workers_--;
+				cv_open_.notify_all();
+			}
+			// The camera is not touched past here, so the callback may
+			// destroy it.
+			if (callback) callback(code);
+		}).detach();
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> _(mtx_open_);
+		opening_ = false;
+		open_workers_--;
+		cv_open_.notify_all();
+		throw;
+	}
+}
+
+std::future<ErrorCode> CameraPrivate::OpenAsync(const InitParams &params) {
+	std::shared_ptr<std::promise<ErrorCode>> promise = std::make_shared<std::promise<ErrorCode>>();
+	std::future<ErrorCode> future = promise->get_future();
+	OpenAsync(params, [promise](ErrorCode code) {
+		promise->set_value(code);
+	});
+	return future;
+}
+
+bool CameraPrivate::BeginOpen() {
+	std::lock_guard<std::mutex> _(mtx_open_);
+	if (opening_) {
+		LOGE("Error: Camera is already opening");
+		return false;
+	}
+	opening_ = true;
+	close_requested_ = false;
+	return true;
+}
+
+ErrorCode CameraPrivate::EndOpen(ErrorCode code) {
+	std::unique_lock<std::mutex> lock(mtx_open_);
+	while (close_requested_) {
+		close_requested_ = false;
+		lock.unlock();
+		CloseDevice();
+		code = ErrorCode::ERROR_CAMERA_NOT_OPENED;
+		lock.lock();
+	}
+	opening_ = false;
+	return code;
+}
+
 bool CameraPrivate::IsOpened() {
-	return dev_sel_info_.index != -1;
+	return opened_;
+}
+
+bool CameraPrivate::IsDeviceSelected() {
+	return opened_ || opening_;
 }
 
 void CameraPrivate::ImgCallback(EtronDIImageType::Value imgType, int imgId,
 	unsigned char *imgBuf, int imgSize, int width, int height,
 	int serialNumber, void *pParam) {
 	CameraPrivate *p = static_cast<CameraPrivate *>(pParam);
-	std::lock_guard<std::mutex> _(p->mtx_imgs_);
-	if (EtronDIImageType::IsImageColor(imgType)) {
+	int depth_img_width = 0, depth_img_height = 0;
+	ExposureStep exposure_step;
+	bool fired = false;
+	{
+		std::lock_guard<std::mutex> _(p->mtx_imgs_);
+		if (EtronDIImageType::IsImageColor(imgType)) {
 
-	}
-	else if (EtronDIImageType::IsImageDepth(imgType)) {
-		// LOGI("Image callback depth");
-		if (!p->depth_img_buf_) {
-			unsigned int depth_img_width = (unsigned int)(p->stream_depth_info_ptr_[p->depth_res_index_].nWidth);
-			unsigned int depth_img_height = (unsigned int)(p->stream_depth_info_ptr_[p->depth_res_index_].nHeight);
-			p->depth_img_buf_ = (unsigned char*)calloc(depth_img_width*depth_img_height * 2, sizeof(unsigned char));
-			p->depth_data_size_ = depth_img_width * depth_img_height * 2;
 		}
-		memcpy(p->depth_img_buf_, imgBuf, p->depth_data_size_);
+		else if (EtronDIImageType::IsImageDepth(imgType)) {
+			// LOGI("Image callback depth");
+			// Buffers and waiter lists are allocated by Open, so the callback
+			// does not allocate. A NextFrameAsync future allocates on the
+			// thread that asked for it.
+			if (!p->depth_img_buf_) return;
+			memcpy(p->depth_img_buf_, imgBuf, p->depth_data_size_);
+			p->depth_ready_ = true;
+			if (p->depth_publisher_) {
+				p->depth_publisher_->Publish(imgBuf);
+			}
+			depth_img_width = p->stream_depth_info_ptr_[p->depth_res_index_].nWidth;
+			depth_img_height = p->stream_depth_info_ptr_[p->depth_res_index_].nHeight;
+			if (p->exposure_control_) {
+				// Once per delivered frame, so min_interval_frames counts frames.
+				p->exposure_control_->Observe(p->depth_img_buf_, depth_img_width, depth_img_height);
+				exposure_step = p->exposure_control_->Decide();
+			}
+			if (!p->frame_callbacks_.empty()) {
+				// Both keep their capacity, fired_callbacks_ is empty here.
+				p->fired_callbacks_.swap(p->frame_callbacks_);
+				// Close and Open wait for this before they free or grow what
+				// the waiters use below.
+				p->in_frame_callback_ = true;
+				p->frame_callback_thread_ = std::this_thread::get_id();
+				fired = true;
+			}
+		}
+		else {
+			LOGE("Image callback failed. Unknown image type.");
+		}
 	}
-	else {
-		LOGE("Image callback failed. Unknown image type.");
+
+	// Register round trips stay outside the lock so readers never wait on
+	// them. The step is a copy and the backend lives as long as the camera,
+	// so DisableExposureControl meanwhile is fine.
+	ExposureController::Apply(p->register_backend_.get(), exposure_step);
+
+	// Outside the lock, so waiters may call back into the camera.
+	if (fired) {
+		std::uint16_t *frame = p->callback_frame_;
+		cv::Mat depth(depth_img_height, depth_img_width, CV_16UC1, frame);
+		DecodeDepth16(imgBuf, frame, depth.total());
+		for (auto &&callback : p->fired_callbacks_) {
+			callback(ErrorCode::SUCCESS, depth);
+		}
+		p->fired_callbacks_.clear();
+
+		// The camera may be destroyed once this is notified, nothing of it
+		// is touched after.
+		std::lock_guard<std::mutex> _(p->mtx_imgs_);
+		free(p->orphan_frame_);
+		p->orphan_frame_ = nullptr;
+		p->in_frame_callback_ = false;
+		p->cv_imgs_.notify_all();
 	}
 }
 
@@ -291,20 +601,20 @@ ErrorCode CameraPrivate::RetrieveDepth() {
 		return ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
 	}
 
-	std::lock_guard<std::mutex> _(mtx_imgs_);
-
 	bool depth_ok = false;
-	if (depth_img_buf_) {
-		unsigned int depth_img_width = (unsigned int)(stream_depth_info_ptr_[depth_res_index_].nWidth);
-		unsigned int depth_img_height = (unsigned int)(stream_depth_info_ptr_[depth_res_index_].nHeight);
-
-		unsigned int point_x = depth_img_width >> 1;
-		unsigned int point_y = depth_img_height >> 1;
-
-		int index = point_y * depth_img_width * 2 + point_x * 2;
-		depth_min = ushort(depth_img_buf_[index + 1]) << 8;
-		depth_min += ushort(depth_img_buf_[index]);
-		depth_ok = true;
+	{
+		std::lock_guard<std::mutex> _(mtx_imgs_);
+		if (depth_img_buf_ && depth_ready_) {
+			unsigned int depth_img_width = (unsigned int)(stream_depth_info_ptr_[depth_res_index_].nWidth);
+			unsigned int depth_img_height = (unsigned int)(stream_depth_info_ptr_[depth_res_index_].nHeight);
+
+			unsigned int point_x = depth_img_width >> 1;
+			unsigned int point_y = depth_img_height >> 1;
+
+			int index = point_y * depth_img_width * 2 + point_x * 2;
+			DecodeDepth16(depth_img_buf_ + index, &depth_min, 1);
+			depth_ok = true;
+		}
 	}
 
 	if (depth_ok) {
@@ -319,55 +629,337 @@ ushort CameraPrivate::GetMinDepth() {
 	return depth_min;
 }
 
+ErrorCode CameraPrivate::RetrieveDepthImage(cv::Mat &mat) {
+	if (!IsOpened()) return ErrorCode::ERROR_CAMERA_NOT_OPENED;
+
+	std::lock_guard<std::mutex> _(mtx_imgs_);
+	if (!depth_img_buf_ || !depth_ready_) {
+		return ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
+	}
+
+	int depth_img_width = stream_depth_info_ptr_[depth_res_index_].nWidth;
+	int depth_img_height = stream_depth_info_ptr_[depth_res_index_].nHeight;
+	mat.create(depth_img_height, depth_img_width, CV_16UC1);
+	DecodeDepth16(depth_img_buf_, mat.ptr<std::uint16_t>(), mat.total());
+	return ErrorCode::SUCCESS;
+}
+
+ErrorCode CameraPrivate::RetrieveDepthImage(cv::Mat &mat, cv::Mat &confidence,
+	const DepthConfidenceParams &params) {
+	ErrorCode code = RetrieveDepthImage(mat);
+	if (code == ErrorCode::SUCCESS) {
+		// Works on the copy, so the callback is not held up.
+		ComputeDepthConfidence(mat, confidence, params);
+	}
+	return code;
+}
+
+void CameraPrivate::NextFrameAsync(Camera::DepthFrameCallback callback) {
+	if (!callback) return;
+	{
+		std::lock_guard<std::mutex> _(mtx_imgs_);
+		if (IsOpened() && depth_img_buf_) {
+			frame_callbacks_.push_back(std::move(callback));
+			return;
+		}
+	}
+	callback(ErrorCode::ERROR_CAMERA_NOT_OPENED, cv::Mat());
+}
+
+std::future<ErrorCode> CameraPrivate::NextFrameAsync(cv::Mat &depth) {
+	std::shared_ptr<std::promise<ErrorCode>> promise = std::make_shared<std::promise<ErrorCode>>();
+	std::future<ErrorCode> future = promise->get_future();
+	{
+		// Sized here, so the copy on the callback thread does not allocate.
+		std::lock_guard<std::mutex> _(mtx_imgs_);
+		if (IsOpened() && depth_img_buf_) {
+			depth.create(stream_depth_info_ptr_[depth_res_index_].nHeight,
+				stream_depth_info_ptr_[depth_res_index_].nWidth, CV_16UC1);
+		}
+	}
+	cv::Mat *out = &depth;
+	NextFrameAsync([promise, out](ErrorCode code, const cv::Mat &frame) {
+		if (code == ErrorCode::SUCCESS) frame.copyTo(*out);
+		promise->set_value(code);
+	});
+	return future;
+}
+
+void CameraPrivate::CancelFrameCallbacks(ErrorCode code) {
+	std::vector<Camera::DepthFrameCallback> callbacks;
+	{
+		std::lock_guard<std::mutex> _(mtx_imgs_);
+		callbacks.swap(frame_callbacks_);
+	}
+	for (auto &&callback : callbacks) {
+		callback(code, cv::Mat());
+	}
+}
+
+ErrorCode CameraPrivate::EnableDepthPublisher(const std::string &name, std::int32_t slot_count) {
+	if (!IsOpened()) return ErrorCode::ERROR_CAMERA_NOT_OPENED;
+
+	std::unique_ptr<DepthPublisher> publisher(new DepthPublisher());
+	ErrorCode code = publisher->Create(name,
+		stream_depth_info_ptr_[depth_res_index_].nWidth,
+		stream_depth_info_ptr_[depth_res_index_].nHeight, slot_count);
+	if (code != ErrorCode::SUCCESS) return code;
+
+	std::lock_guard<std::mutex> _(mtx_imgs_);
+	depth_publisher_ = std::move(publisher);
+	return ErrorCode::SUCCESS;
+}
+
+void CameraPrivate::DisableDepthPublisher() {
+	std::lock_guard<std::mutex> _(mtx_imgs_);
+	depth_publisher_.reset();
+}
+
+ErrorCode CameraPrivate::EnableExposureControl(const ExposureControlParams &params) {
+	if (!IsOpened()) return ErrorCode::ERROR_CAMERA_NOT_OPENED;
+
+	// The loop writes these from the frame callback.
+	ReserveRegisterShadow(RegisterType::FW, 0, params.ir_address);
+	if (params.exposure_address) {
+		ReserveRegisterShadow(RegisterType::SENSOR, params.exposure_sensor_id, params.exposure_address);
+	}
+	std::unique_ptr<ExposureController> control(new ExposureController(register_backend_.get(), params));
+	control->Reset(ir_intensity_);
+	std::lock_guard<std::mutex> _(mtx_imgs_);
+	exposure_control_ = std::move(control);
+	return ErrorCode::SUCCESS;
+}
+
+void CameraPrivate::DisableExposureControl() {
+	std::lock_guard<std::mutex> _(mtx_imgs_);
+	exposure_control_.reset();
+}
+
+StartupTimings CameraPrivate::GetStartupTimings() {
+	std::lock_guard<std::mutex> _(mtx_timings_);
+	return startup_timings_;
+}
+
 void CameraPrivate::Close() {
+	{
+		std::lock_guard<std::mutex> _(mtx_open_);
+		if (opening_) {
+			// Not waiting for it, the opening thread closes once Open returns.
+			close_requested_ = true;
+			return;
+		}
+	}
+	CloseDevice();
+}
+
+void CameraPrivate::CloseDevice() {
+	opened_ = false;
+	ClearRegisterShadow();
 	if (dev_sel_info_.index != -1) {
 		EtronDI_CloseDevice(etron_di_, &dev_sel_info_);
 		dev_sel_info_.index = -1;
 	}
+	CancelFrameCallbacks(ErrorCode::ERROR_CAMERA_NOT_OPENED);
+	DisableDepthPublisher();
+	DisableExposureControl();
 	ReleaseBuf();
+#ifdef MYNTEYE_EMBEDDED
+	LOGI("-- Peak RSS: %.1f MB", GetPeakResidentSize() / (1024.0 * 1024.0));
+#endif
+}
+
+bool CameraPrivate::AllocateBuf() {
+	std::unique_lock<std::mutex> lock(mtx_imgs_);
+	if (!WaitFrameCallback(lock)) {
+		LOGE("Error: Open from a NextFrameAsync callback is not supported");
+		return false;
+	}
+	unsigned int depth_img_width = (unsigned int)(stream_depth_info_ptr_[depth_res_index_].nWidth);
+	unsigned int depth_img_height = (unsigned int)(stream_depth_info_ptr_[depth_res_index_].nHeight);
+	depth_data_size_ = depth_img_width * depth_img_height * 2;
+	if (depth_data_size_ <= 0) {
+		LOGE("Error: Invalid depth stream resolution %dx%d", depth_img_width, depth_img_height);
+		return false;
+	}
+
+	depth_ready_ = false;
+	frame_callbacks_.reserve(kFrameCallbackReserve);
+	fired_callbacks_.reserve(kFrameCallbackReserve);
+#ifdef MYNTEYE_EMBEDDED
+	// Room for the frame, the waiters' frame and alignment padding, reused
+	// across reopens.
+	std::size_t capacity = std::size_t(depth_data_size_) * 2 + 128;
+	if (!frame_arena_.Reserve(capacity)) {
+		LOGE("Error: Reserve frame arena of %d bytes failed", int(capacity));
+		return false;
+	}
+	depth_img_buf_ = static_cast<unsigned char *>(frame_arena_.Allocate(depth_data_size_));
+	callback_frame_ = static_cast<std::uint16_t *>(frame_arena_.Allocate(depth_data_size_));
+#else
+	depth_img_buf_ = (unsigned char*)calloc(depth_data_size_, sizeof(unsigned char));
+	callback_frame_ = (std::uint16_t*)calloc(depth_data_size_, sizeof(unsigned char));
+#endif
+	return depth_img_buf_ != nullptr && callback_frame_ != nullptr;
 }
 
 void CameraPrivate::ReleaseBuf() {
-	if (depth_img_buf_) {
-		delete depth_img_buf_;
-		depth_img_buf_ = nullptr;
+	std::unique_lock<std::mutex> lock(mtx_imgs_);
+	if (!WaitFrameCallback(lock)) {
+		// Closing from a waiter, the callback is still on the frame and
+		// frees it once done. The arena keeps its memory until Open
+		// reserves again.
+#ifndef MYNTEYE_EMBEDDED
+		if (callback_frame_) orphan_frame_ = callback_frame_;
+		callback_frame_ = nullptr;
+#endif
+	}
+#ifdef MYNTEYE_EMBEDDED
+	frame_arena_.Reset();
+#else
+	free(depth_img_buf_);
+	free(callback_frame_);
+#endif
+	depth_img_buf_ = nullptr;
+	callback_frame_ = nullptr;
+}
+
+bool CameraPrivate::WaitFrameCallback(std::unique_lock<std::mutex> &lock) {
+	if (in_frame_callback_ && frame_callback_thread_ == std::this_thread::get_id()) {
+		return false;
 	}
+	cv_imgs_.wait(lock, [this]() { return !in_frame_callback_; });
+	return true;
 }
 
 bool CameraPrivate::GetSensorRegister(int id, unsigned short address, unsigned short *value, int flag) {
-	if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
+	if (!IsDeviceSelected()) throw std::runtime_error("Error: Camera not opened.");
 #ifdef OS_WIN
-	return ETronDI_OK == EtronDI_GetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, 2);
+	bool ok = ETronDI_OK == EtronDI_GetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, 2);
 #else
-	return ETronDI_OK == EtronDI_GetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, SENSOR_BOTH);
+	bool ok = ETronDI_OK == EtronDI_GetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, SENSOR_BOTH);
 #endif
+	RememberRegister(RegisterType::SENSOR, id, address, *value, ok);
+	return ok;
 }
 
 bool CameraPrivate::GetHWRegister(unsigned short address, unsigned short *value, int flag) {
-	if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
-	return ETronDI_OK == EtronDI_GetHWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	if (!IsDeviceSelected()) throw std::runtime_error("Error: Camera not opened.");
+	bool ok = ETronDI_OK == EtronDI_GetHWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	RememberRegister(RegisterType::HW, 0, address, *value, ok);
+	return ok;
 }
 
 bool CameraPrivate::GetFWRegister(unsigned short address, unsigned short *value, int flag) {
-	if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
-	return ETronDI_OK == EtronDI_GetFWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	if (!IsDeviceSelected()) throw std::runtime_error("Error: Camera not opened.");
+	bool ok = ETronDI_OK == EtronDI_GetFWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	RememberRegister(RegisterType::FW, 0, address, *value, ok);
+	return ok;
 }
 
 bool CameraPrivate::SetSensorRegister(int id, unsigned short address, unsigned short value, int flag) {
-	if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
+	if (!IsDeviceSelected()) throw std::runtime_error("Error: Camera not opened.");
 #ifdef OS_WIN
-	return ETronDI_OK == EtronDI_SetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, 2);
+	bool ok = ETronDI_OK == EtronDI_SetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, 2);
 #else
-	return ETronDI_OK == EtronDI_SetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, SENSOR_BOTH);
+	bool ok = ETronDI_OK == EtronDI_SetSensorRegister(etron_di_, &dev_sel_info_, id, address, value, flag, SENSOR_BOTH);
 #endif
+	RememberRegister(RegisterType::SENSOR, id, address, value, ok);
+	return ok;
 }
 
 bool CameraPrivate::SetHWRegister(unsigned short address, unsigned short value, int flag) {
-	if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
-	return ETronDI_OK == EtronDI_SetHWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	if (!IsDeviceSelected()) throw std::runtime_error("Error: Camera not opened.");
+	bool ok = ETronDI_OK == EtronDI_SetHWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	RememberRegister(RegisterType::HW, 0, address, value, ok);
+	return ok;
 }
 
 bool CameraPrivate::SetFWRegister(unsigned short address, unsigned short value, int flag) {
-	if (!IsOpened()) throw std::runtime_error("Error: Camera not opened.");
-	return ETronDI_OK == EtronDI_SetFWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	if (!IsDeviceSelected()) throw std::runtime_error("Error: Camera not opened.");
+	bool ok = ETronDI_OK == EtronDI_SetFWRegister(etron_di_, &dev_sel_info_, address, value, flag);
+	RememberRegister(RegisterType::FW, 0, address, value, ok);
+	return ok;
+}
+
+void CameraPrivate::ReadRegisters(std::vector<RegisterOp> &ops) {
+	std::map<std::uint64_t, std::size_t> first;
+	for (std::size_t i = 0; i < ops.size(); i++) {
+		RegisterOp &op = ops[i];
+		std::uint64_t key = RegisterKey(op.type, op.sensor_id, op.address);
+		auto it = first.find(key);
+		if (it != first.end()) {
+			op.value = ops[it->second].value;
+			op.ok = ops[it->second].ok;
+			continue;
+		}
+		first[key] = i;
+		switch (op.type) {
+		case RegisterType::SENSOR:
+			op.ok = GetSensorRegister(op.sensor_id, op.address, &op.value);
+			break;
+		case RegisterType::HW:
+			op.ok = GetHWRegister(op.address, &op.value);
+			break;
+		case RegisterType::FW:
+			op.ok = GetFWRegister(op.address, &op.value);
+			break;
+		}
+	}
+}
+
+void CameraPrivate::WriteRegisters(std::vector<RegisterOp> &ops) {
+	std::map<std::uint64_t, std::size_t> last;
+	for (std::size_t i = 0; i < ops.size(); i++) {
+		last[RegisterKey(ops[i].type, ops[i].sensor_id, ops[i].address)] = i;
+	}
+	for (std::size_t i = 0; i < ops.size(); i++) {
+		RegisterOp &op = ops[i];
+		std::uint64_t key = RegisterKey(op.type, op.sensor_id, op.address);
+		if (last[key] != i) continue;
+		if (ShadowHolds(key, op.value)) {
+			op.ok = true;
+			continue;
+		}
+		switch (op.type) {
+		case RegisterType::SENSOR:
+			op.ok = SetSensorRegister(op.sensor_id, op.address, op.value);
+			break;
+		case RegisterType::HW:
+			op.ok = SetHWRegister(op.address, op.value);
+			break;
+		case RegisterType::FW:
+			op.ok = SetFWRegister(op.address, op.value);
+			break;
+		}
+	}
+	// Superseded writes report the outcome of the write that replaced them.
+	for (std::size_t i = 0; i < ops.size(); i++) {
+		ops[i].ok = ops[last[RegisterKey(ops[i].type, ops[i].sensor_id, ops[i].address)]].ok;
+	}
+}
+
+void CameraPrivate::RememberRegister(RegisterType type, int id, unsigned short address,
+	unsigned short value, bool known) {
+	std::lock_guard<std::mutex> _(mtx_registers_);
+	ShadowRegister &shadow = register_shadow_[RegisterKey(type, id, address)];
+	shadow.value = value;
+	shadow.known = known;
+}
+
+bool CameraPrivate::ShadowHolds(std::uint64_t key, unsigned short value) {
+	std::lock_guard<std::mutex> _(mtx_registers_);
+	auto shadow = register_shadow_.find(key);
+	return shadow != register_shadow_.end() && shadow->second.known && shadow->second.value == value;
+}
+
+void CameraPrivate::ReserveRegisterShadow(RegisterType type, int id, unsigned short address) {
+	std::lock_guard<std::mutex> _(mtx_registers_);
+	register_shadow_.insert(std::make_pair(RegisterKey(type, id, address), ShadowRegister{ 0, false }));
+}
+
+void CameraPrivate::ClearRegisterShadow() {
+	std::lock_guard<std::mutex> _(mtx_registers_);
+	for (auto &&entry : register_shadow_) {
+		entry.second.known = false;
+	}
 }
\ No newline at end of file
@@ -16,6 +16,9 @@
 #pragma once
 
 #include "camera.h"
+#include "depth_shm.h"
+#include "device_cache.h"
+#include "memory_profile.h"
 
 #include "eSPDI.h"
 
@@ -31,7 +34,13 @@ extern "C" {
 #include <Windows.h>
 #endif
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace mynteye {
 
@@ -49,6 +58,7 @@ namespace mynteye {
 		void GetDevices(std::vector<DeviceInfo> &dev_infos);
 		void GetResolutions(const std::int32_t &dev_index,
 			std::vector<StreamInfo> &color_infos, std::vector<StreamInfo> &depth_infos);
+		void SetDeviceCachePath(const std::string &path);
 
 		ErrorCode SetAutoExposureEnabled(bool enabled);
 		ErrorCode SetAutoWhiteBalanceEnabled(bool enabled);
@@ -61,13 +71,33 @@ namespace mynteye {
 		bool SetHWRegister(unsigned short address, unsigned short value, int flag = FG_Address_1Byte);
 		bool SetFWRegister(unsigned short address, unsigned short value, int flag = FG_Address_1Byte);
 
+		void ReadRegisters(std::vector<RegisterOp> &ops);
+		void WriteRegisters(std::vector<RegisterOp> &ops);
+
 		ErrorCode Open(const InitParams &params);
+		void OpenAsync(const InitParams &params, Camera::OpenCallback callback);
+		std::future<ErrorCode> OpenAsync(const InitParams &params);
 
 		bool IsOpened();
 
 		ErrorCode RetrieveDepth();
 		ushort GetMinDepth();
 
+		ErrorCode RetrieveDepthImage(cv::Mat &mat);
+		ErrorCode RetrieveDepthImage(cv::Mat &mat, cv::Mat &confidence,
+			const DepthConfidenceParams &params);
+
+		void NextFrameAsync(Camera::DepthFrameCallback callback);
+		std::future<ErrorCode> NextFrameAsync(cv::Mat &depth);
+
+		ErrorCode EnableDepthPublisher(const std::string &name, std::int32_t slot_count);
+		void DisableDepthPublisher();
+
+		ErrorCode EnableExposureControl(const ExposureControlParams &params);
+		void DisableExposureControl();
+
+		StartupTimings GetStartupTimings();
+
 		void Close();
 
 		/** q-ptr that points to the API class */
@@ -75,11 +105,41 @@ namespace mynteye {
 
 	private:
 		//ErrorCode RetrieveColorImage(cv::Mat &mat);
-		//ErrorCode RetrieveDepthImage(cv::Mat &mat);
 
+		void LoadResolutions(std::int32_t dev_index);
+
+		/** Marks an open in progress, false if one already is. */
+		bool BeginOpen();
+		/** Ends the open, closing the device if Close was called meanwhile. */
+		ErrorCode EndOpen(ErrorCode code);
+		ErrorCode OpenDevice(const InitParams &params);
+		void CloseDevice();
+		/** Opened or opening, Open writes registers before the device streams. */
+		bool IsDeviceSelected();
+		/** Completes every pending NextFrameAsync with code. */
+		void CancelFrameCallbacks(ErrorCode code);
+
+		bool AllocateBuf();
 		void ReleaseBuf();
+		/**
+		 * Waits until the callback is done calling waiters, which read
+		 * callback_frame_ and fired_callbacks_ without the lock. False on
+		 * the callback thread itself, a waiter that closes or opens.
+		 */
+		bool WaitFrameCallback(std::unique_lock<std::mutex> &lock);
+
+		std::string GetSerialNumber(std::int32_t dev_index);
+		void RememberRegister(RegisterType type, int id, unsigned short address,
+			unsigned short value, bool known);
+		bool ShadowHolds(std::uint64_t key, unsigned short value);
+		/**
+		 * Adds an entry that holds no value yet, so remembering a register
+		 * the frame callback writes does not allocate.
+		 */
+		void ReserveRegisterShadow(RegisterType type, int id, unsigned short address);
+		/** Forgets every value, entries are kept for reuse. */
+		void ClearRegisterShadow();
 
-#ifdef OS_WIN
 		static void ImgCallback(EtronDIImageType::Value imgType, int imgId,
 			unsigned char *imgBuf, int imgSize, int width, int height,
 			int serialNumber, void *pParam);
@@ -87,7 +147,6 @@ namespace mynteye {
 		std::mutex mtx_imgs_;
 
 		int depth_data_size_;
-#endif
 
 		void *etron_di_;
 
@@ -96,18 +155,77 @@ namespace mynteye {
 
 		PETRONDI_STREAM_INFO stream_color_info_ptr_;
 		PETRONDI_STREAM_INFO stream_depth_info_ptr_;
+#ifdef MYNTEYE_EMBEDDED
+		ETRONDI_STREAM_INFO stream_color_infos_[64];
+		ETRONDI_STREAM_INFO stream_depth_infos_[64];
+		/** Holds every frame buffer of the opened resolution. */
+		FrameArena frame_arena_;
+#endif
 		int color_res_index_;
 		int depth_res_index_;
 
 		int framerate_;
 
 		std::int32_t stream_info_dev_index_;
+		/** Serial number of the device the stream infos were loaded from. */
+		std::string stream_info_serial_;
 
 		unsigned char *depth_img_buf_;
+		/** Set once the callback filled depth_img_buf_ since Open. */
+		bool depth_ready_;
+		/** Pending NextFrameAsync waiters, guarded by mtx_imgs_. */
+		std::vector<Camera::DepthFrameCallback> frame_callbacks_;
+		/**
+		 * Waiters being called and the frame they get, only touched by the
+		 * callback. Both are allocated by Open, so the callback does not.
+		 */
+		std::vector<Camera::DepthFrameCallback> fired_callbacks_;
+		std::uint16_t *callback_frame_;
+		/** Set while the callback calls waiters, guarded by mtx_imgs_. */
+		bool in_frame_callback_;
+		std::thread::id frame_callback_thread_;
+		/** Notified once the callback is done calling waiters. */
+		std::condition_variable cv_imgs_;
+		/** A frame Close from a waiter released, the callback frees it. */
+		std::uint16_t *orphan_frame_;
+
+		/** Set from the start of Open until it returns, guarded by mtx_open_. */
+		std::atomic<bool> opening_;
+		/** Set once the device streams, what IsOpened reports. */
+		std::atomic<bool> opened_;
+		/** Close during an open, the opening thread closes once done. */
+		bool close_requested_;
+		/** OpenAsync workers still running, the destructor waits for them. */
+		int open_workers_;
+		std::mutex mtx_open_;
+		std::condition_variable cv_open_;
 
 		DepthMode depth_mode_;
 		cv::Mat depth_raw_;
 		ushort depth_min;
+
+		std::unique_ptr<DepthPublisher> depth_publisher_;
+
+		std::int32_t ir_intensity_;
+		std::unique_ptr<RegisterBackend> register_backend_;
+		std::unique_ptr<ExposureController> exposure_control_;
+
+		DeviceCache device_cache_;
+		/**
+		 * Last value written to or read back from each register since Open,
+		 * guarded by mtx_registers_. The device changes sensor exposure and
+		 * gain registers on its own while auto-exposure is on, so the shadow
+		 * can be stale for those.
+		 */
+		struct ShadowRegister {
+			unsigned short value;
+			bool known;
+		};
+		std::map<std::uint64_t, ShadowRegister> register_shadow_;
+		std::mutex mtx_registers_;
+		/** Guarded by mtx_timings_, Open may run on an OpenAsync worker. */
+		StartupTimings startup_timings_;
+		std::mutex mtx_timings_;
 	};
 
 }  // namespace mynteye
@@ -0,0 +1,411 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "depth_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "simd.h"
+
+using namespace mynteye;
+
+namespace {
+
+// Unary prefixes of this length are followed by the raw residual.
+const int kRiceEscape = 24;
+// Zig-zag residuals of 16-bit samples need 17 bits.
+const int kRawBits = 17;
+const int kRiceParamBits = 5;
+const int kMaxRiceParam = 16;
+// Pixels decoded per batch on lossy rows.
+const int kDecodeChunk = 64;
+
+inline std::uint32_t ZigZag(std::int32_t r) {
+    return (std::uint32_t(r) << 1) ^ std::uint32_t(r >> 31);
+}
+
+inline std::int32_t UnZigZag(std::uint32_t u) {
+    return std::int32_t(u >> 1) ^ -std::int32_t(u & 1);
+}
+
+inline int CountLeadingZeros(std::uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return 63 - int(index);
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+inline std::uint64_t LoadBigEndian64(const std::uint8_t *p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+#ifdef _MSC_VER
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+inline std::uint16_t ClampDepth(std::int64_t v) {
+    return std::uint16_t(v < 0 ? 0 : (v > 0xFFFF ? 0xFFFF : v));
+}
+
+/**
+ * Divides by a constant step with a multiply, exact for the |r| + e < 2^18
+ * range of depth residuals.
+ */
+class Quantizer {
+public:
+    explicit Quantizer(std::int32_t e)
+        : e_(e), step_(2 * e + 1),
+          magic_(((std::uint64_t(1) << 40) + std::uint64_t(step_) - 1) / std::uint64_t(step_)) {}
+
+    std::int32_t step() const { return step_; }
+
+    inline std::int32_t operator()(std::int32_t r) const {
+        if (r >= 0) return Divide(r + e_);
+        return -Divide(e_ - r);
+    }
+
+private:
+    inline std::int32_t Divide(std::int32_t a) const {
+        return std::int32_t((std::uint64_t(a) * magic_) >> 40);
+    }
+
+    std::int32_t e_;
+    std::int32_t step_;
+    std::uint64_t magic_;
+};
+
+/** MSB-first bit writer into a buffer sized for the worst case. */
+class BitWriter {
+public:
+    explicit BitWriter(std::uint8_t *out) : out_(out), pos_(0), acc_(0), count_(0) {}
+
+    // n <= 32
+    inline void Put(std::uint32_t v, int n) {
+        acc_ = (acc_ << n) | v;
+        count_ += n;
+        if (count_ >= 32) {
+            count_ -= 32;
+            std::uint32_t word = std::uint32_t(acc_ >> count_);
+            out_[pos_++] = std::uint8_t(word >> 24);
+            out_[pos_++] = std::uint8_t(word >> 16);
+            out_[pos_++] = std::uint8_t(word >> 8);
+            out_[pos_++] = std::uint8_t(word);
+        }
+    }
+
+    inline void PutRice(std::uint32_t v, int k) {
+        std::uint32_t q = v >> k;
+        if (q < std::uint32_t(kRiceEscape)) {
+            int n = int(q) + 1 + k;
+            std::uint32_t low = v & ((1u << k) - 1);
+            if (n <= 32) {
+                Put((1u << k) | low, n);
+            }
+            else {
+                Put(1, int(q) + 1);
+                Put(low, k);
+            }
+        }
+        else {
+            Put(1, kRiceEscape + 1);
+            Put(v, kRawBits);
+        }
+    }
+
+    std::size_t Finish() {
+        while (count_ >= 8) {
+            count_ -= 8;
+            out_[pos_++] = std::uint8_t(acc_ >> count_);
+        }
+        if (count_ > 0) {
+            out_[pos_++] = std::uint8_t(acc_ << (8 - count_));
+            count_ = 0;
+        }
+        return pos_;
+    }
+
+private:
+    std::uint8_t *out_;
+    std::size_t pos_;
+    std::uint64_t acc_;
+    int count_;
+};
+
+/** MSB-first bit reader, reads zeros past the end and records the overrun. */
+class BitReader {
+public:
+    BitReader(const std::uint8_t *data, std::size_t size)
+        : p_(data), end_(data + size), acc_(0), count_(0), padding_(0) {}
+
+    inline void Refill() {
+        // Branch free while 8 bytes remain: bits below count_ come from
+        // the bytes at p_, so loading them again is harmless.
+        if (end_ - p_ >= 8) {
+            std::uint64_t word = LoadBigEndian64(p_);
+            acc_ |= word >> count_;
+            p_ += (63 - count_) >> 3;
+            count_ |= 56;
+            return;
+        }
+        if (count_ > 56) return;
+        while (count_ <= 56) {
+            std::uint64_t b = 0;
+            if (p_ < end_) {
+                b = *p_++;
+            }
+            else {
+                ++padding_;
+            }
+            acc_ |= b << (56 - count_);
+            count_ += 8;
+        }
+    }
+
+    // 0 < n <= 32
+    inline std::uint32_t Get(int n) {
+        Refill();
+        return Take(n);
+    }
+
+    /** Returns the Rice coded value, or false if the code is invalid. */
+    inline bool GetRice(int k, std::uint32_t *v) {
+        Refill();
+        int zeros = acc_ ? CountLeadingZeros(acc_) : 64;
+        if (zeros > kRiceEscape) return false;
+        acc_ <<= zeros + 1;
+        count_ -= zeros + 1;
+        // A refill leaves at least 57 bits, enough for prefix and suffix.
+        if (zeros == kRiceEscape) {
+            *v = Take(kRawBits);
+        }
+        else {
+            *v = (std::uint32_t(zeros) << k) | (k ? Take(k) : 0);
+        }
+        return true;
+    }
+
+    /** True if no bit past the end of the data was consumed. */
+    bool Valid() const {
+        return std::int64_t(padding_) * 8 <= count_;
+    }
+
+private:
+    inline std::uint32_t Take(int n) {
+        std::uint32_t v = std::uint32_t(acc_ >> (64 - n));
+        acc_ <<= n;
+        count_ -= n;
+        return v;
+    }
+
+    const std::uint8_t *p_;
+    const std::uint8_t *end_;
+    std::uint64_t acc_;
+    int count_;
+    std::size_t padding_;
+};
+
+std::size_t MaxEncodedSize(int width, int height) {
+    std::size_t bits = std::size_t(height) * kRiceParamBits +
+        std::size_t(width) * height * (kRiceEscape + 1 + kRawBits);
+    return (bits + 7) / 8 + 8;
+}
+
+bool DecodeFrame(std::uint16_t max_error, const std::uint8_t *payload, std::size_t size,
+        int width, int height, std::uint16_t *depth) {
+    if (width <= 0 || height <= 0) return false;
+    BitReader r(payload, size);
+    const std::int32_t e = max_error;
+    // 64-bit, a hostile code times the packet's step overflows 32 bits.
+    const std::int64_t step = 2 * e + 1;
+    const std::uint16_t *above = nullptr;
+    for (int y = 0; y < height; y++) {
+        int k = int(r.Get(kRiceParamBits));
+        if (k > kMaxRiceParam) return false;
+        std::uint16_t *row = depth + std::size_t(y) * width;
+        std::int32_t pred = above ? above[0] : 0;
+        if (e != 0 && above) {
+            // Codes first, then the reconstruction as a vectorizable pass.
+            std::uint32_t codes[kDecodeChunk];
+            for (int x0 = 0; x0 < width; x0 += kDecodeChunk) {
+                int n = std::min(kDecodeChunk, width - x0);
+                for (int i = 0; i < n; i++) {
+                    if (!r.GetRice(k, &codes[i])) return false;
+                }
+                for (int i = 0; i < n; i++) {
+                    row[x0 + i] = ClampDepth(std::int64_t(above[x0 + i]) + UnZigZag(codes[i]) * step);
+                }
+            }
+        }
+        else if (e == 0) {
+            for (int x = 0; x < width; x++) {
+                std::uint32_t u;
+                if (!r.GetRice(k, &u)) return false;
+                pred += UnZigZag(u);
+                if (std::uint32_t(pred) > 0xFFFF) return false;
+                row[x] = std::uint16_t(pred);
+            }
+        }
+        else {
+            for (int x = 0; x < width; x++) {
+                std::uint32_t u;
+                if (!r.GetRice(k, &u)) return false;
+                row[x] = ClampDepth(pred + UnZigZag(u) * step);
+                pred = row[x];
+            }
+        }
+        above = row;
+    }
+    return r.Valid();
+}
+
+inline void Put16(std::uint8_t *p, std::uint16_t v) {
+    p[0] = std::uint8_t(v);
+    p[1] = std::uint8_t(v >> 8);
+}
+
+inline void Put32(std::uint8_t *p, std::uint32_t v) {
+    Put16(p, std::uint16_t(v));
+    Put16(p + 2, std::uint16_t(v >> 16));
+}
+
+inline std::uint16_t Get16(const std::uint8_t *p) {
+    return std::uint16_t(p[0] | (p[1] << 8));
+}
+
+inline std::uint32_t Get32(const std::uint8_t *p) {
+    return std::uint32_t(Get16(p)) | (std::uint32_t(Get16(p + 2)) << 16);
+}
+
+}  // namespace
+
+DepthCodec::DepthCodec(std::uint16_t max_error) : max_error_(max_error) {
+}
+
+DepthCodec::~DepthCodec() {
+}
+
+void DepthCodec::Encode(const std::uint16_t *depth, int width, int height,
+        std::vector<std::uint8_t> &payload) {
+    payload.resize(EncodeTo(depth, width, height, payload, 0));
+}
+
+bool DepthCodec::Decode(const std::uint8_t *payload, std::size_t size,
+        int width, int height, std::uint16_t *depth) {
+    return DecodeFrame(max_error_, payload, size, width, height, depth);
+}
+
+void DepthCodec::EncodePacket(const std::uint16_t *depth, int width, int height,
+        std::uint32_t sequence, std::vector<std::uint8_t> &packet) {
+    std::size_t payload_size = EncodeTo(depth, width, height, packet, kPacketHeaderSize);
+    packet.resize(kPacketHeaderSize + payload_size);
+
+    std::uint8_t *p = packet.data();
+    Put32(p, kPacketMagic);
+    p[4] = kPacketVersion;
+    p[5] = 0;
+    Put16(p + 6, max_error_);
+    Put16(p + 8, std::uint16_t(width));
+    Put16(p + 10, std::uint16_t(height));
+    Put32(p + 12, sequence);
+    Put32(p + 16, std::uint32_t(payload_size));
+}
+
+std::int64_t DepthCodec::ParsePacket(const std::uint8_t *data, std::size_t size,
+        DepthPacketHeader &header) {
+    if (size < kPacketHeaderSize) return 0;
+    header.magic = Get32(data);
+    header.version = data[4];
+    header.flags = data[5];
+    header.max_error = Get16(data + 6);
+    header.width = Get16(data + 8);
+    header.height = Get16(data + 10);
+    header.sequence = Get32(data + 12);
+    header.payload_size = Get32(data + 16);
+    if (header.magic != kPacketMagic || header.version != kPacketVersion) return -1;
+    if (header.payload_size > MaxEncodedSize(header.width, header.height)) return -1;
+    std::int64_t total = std::int64_t(kPacketHeaderSize) + header.payload_size;
+    return std::int64_t(size) < total ? 0 : total;
+}
+
+bool DepthCodec::DecodePacket(const std::uint8_t *data, std::size_t size,
+        DepthPacketHeader &header, std::uint16_t *depth) {
+    if (ParsePacket(data, size, header) <= 0) return false;
+    return DecodeFrame(header.max_error, data + kPacketHeaderSize, header.payload_size,
+        header.width, header.height, depth);
+}
+
+std::size_t DepthCodec::EncodeTo(const std::uint16_t *depth, int width, int height,
+        std::vector<std::uint8_t> &out, std::size_t offset) {
+    if (width <= 0 || height <= 0) return 0;
+    out.resize(offset + MaxEncodedSize(width, height));
+    residuals_.resize(width);
+    BitWriter w(out.data() + offset);
+
+    const bool lossy = max_error_ > 0;
+    const Quantizer quantize(max_error_);
+    const std::int32_t step = quantize.step();
+    if (lossy) recon_.resize(std::size_t(width) * 2);
+
+    std::uint32_t *res = residuals_.data();
+    const std::uint16_t *above = nullptr;
+    for (int y = 0; y < height; y++) {
+        const std::uint16_t *row = depth + std::size_t(y) * width;
+        if (lossy) {
+            // Predict from reconstructed samples so the decoder stays in step.
+            std::uint16_t *recon = recon_.data() + std::size_t(y & 1) * width;
+            if (above) {
+                // From the row above, so every pixel is independent.
+                QuantizeDelta16(row, above, max_error_, recon, res, std::size_t(width));
+            }
+            else {
+                std::int32_t pred = 0;
+                for (int x = 0; x < width; x++) {
+                    std::int32_t q = quantize(std::int32_t(row[x]) - pred);
+                    recon[x] = ClampDepth(pred + q * step);
+                    res[x] = ZigZag(q);
+                    pred = recon[x];
+                }
+            }
+            above = recon;
+        }
+        else {
+            ZigZagDelta16(row, above ? above[0] : 0, res, std::size_t(width));
+            above = row;
+        }
+
+        std::uint64_t sum = 0;
+        for (int x = 0; x < width; x++) {
+            sum += res[x];
+        }
+        int k = 0;
+        while (k < kMaxRiceParam && (std::uint64_t(width) << k) < sum) {
+            k++;
+        }
+
+        w.Put(std::uint32_t(k), kRiceParamBits);
+        for (int x = 0; x < width; x++) {
+            w.PutRice(res[x], k);
+        }
+    }
+    return w.Finish();
+}
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "depth_codec.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: depth_codec_bench <frames.raw> <width> <height> [max_error]
+//
+// frames.raw holds back-to-back 16-bit little-endian depth frames, e.g. the
+// CV_16UC1 mats from Camera::RetrieveDepthImage written out as they come.
+int main(int argc, char const *argv[]) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <frames.raw> <width> <height> [max_error]" << endl;
+        return 1;
+    }
+    int width = atoi(argv[2]);
+    int height = atoi(argv[3]);
+    int max_error = argc > 4 ? atoi(argv[4]) : 0;
+    if (width <= 0 || height <= 0 || max_error < 0 || max_error > 0xFFFF) {
+        cerr << "Error: Invalid frame size or max error" << endl;
+        return 1;
+    }
+
+    ifstream in(argv[1], ios::binary);
+    if (!in) {
+        cerr << "Error: Open " << argv[1] << " failed" << endl;
+        return 1;
+    }
+    size_t frame_pixels = size_t(width) * height;
+    vector<vector<uint16_t>> frames;
+    for (;;) {
+        vector<uint16_t> frame(frame_pixels);
+        if (!in.read(reinterpret_cast<char *>(frame.data()), frame_pixels * 2)) break;
+        frames.push_back(std::move(frame));
+    }
+    if (frames.empty()) {
+        cerr << "Error: No complete frame in " << argv[1] << endl;
+        return 1;
+    }
+
+    DepthCodec codec(static_cast<uint16_t>(max_error));
+    vector<vector<uint8_t>> packets(frames.size());
+    vector<uint16_t> decoded(frame_pixels);
+
+    typedef chrono::steady_clock clock;
+    double encode_ms = 0, decode_ms = 0;
+    size_t encoded_bytes = 0;
+    int worst_error = 0;
+    bool ok = true;
+
+    for (size_t i = 0; i < frames.size(); i++) {
+        clock::time_point t = clock::now();
+        codec.EncodePacket(frames[i].data(), width, height, uint32_t(i), packets[i]);
+        encode_ms += chrono::duration<double, milli>(clock::now() - t).count();
+        encoded_bytes += packets[i].size();
+    }
+    for (size_t i = 0; i < frames.size(); i++) {
+        DepthPacketHeader header;
+        clock::time_point t = clock::now();
+        ok = DepthCodec::DecodePacket(packets[i].data(), packets[i].size(), header, decoded.data()) && ok;
+        decode_ms += chrono::duration<double, milli>(clock::now() - t).count();
+        for (size_t j = 0; j < frame_pixels; j++) {
+            worst_error = max(worst_error, abs(int(decoded[j]) - int(frames[i][j])));
+        }
+    }
+
+    double n = double(frames.size());
+    double raw_mb = n * frame_pixels * 2 / (1024.0 * 1024.0);
+    cout << fixed << setprecision(3);
+    cout << "Frames      : " << frames.size() << " (" << width << "x" << height
+         << ", max error " << max_error << ")" << endl;
+    cout << "Ratio       : " << (n * frame_pixels * 2) / encoded_bytes << endl;
+    cout << "Encode      : " << encode_ms / n << " ms/frame, "
+         << raw_mb / (encode_ms / 1000.0) << " MB/s" << endl;
+    cout << "Decode      : " << decode_ms / n << " ms/frame, "
+         << raw_mb / (decode_ms / 1000.0) << " MB/s" << endl;
+    cout << "Worst error : " << worst_error << endl;
+
+    if (!ok || worst_error > max_error) {
+        cerr << "Error: Round trip mismatch" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "depth_codec.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: depth_codec_test
+//
+// Round-trips synthetic frames at several max_error values, then feeds the
+// decoder hostile packets: headers rewritten to the largest max_error over
+// payloads with huge residuals, truncated and oversized payloads, a wrong
+// magic and random byte flips. The decoder must reject them or clamp, and
+// never read or compute out of range; build with -fsanitize=address,undefined
+// to have that checked.
+
+namespace {
+
+const int kWidth = 97;
+const int kHeight = 31;
+
+mt19937 rng(1);
+
+/** Smooth depth with invalid holes and jumps between 0 and 0xFFFF. */
+vector<uint16_t> MakeFrame() {
+    vector<uint16_t> frame(kWidth * kHeight);
+    for (int y = 0; y < kHeight; y++) {
+        for (int x = 0; x < kWidth; x++) {
+            uint16_t d = uint16_t(1000 + 20 * x + 7 * y + int(rng() % 9));
+            if (rng() % 13 == 0) d = 0;
+            if (rng() % 29 == 0) d = 0xFFFF;
+            frame[y * kWidth + x] = d;
+        }
+    }
+    return frame;
+}
+
+int failures = 0;
+
+void Check(bool ok, const string &what) {
+    cout << (ok ? "ok     " : "FAILED ") << what << endl;
+    if (!ok) failures++;
+}
+
+void TestRoundTrip() {
+    vector<uint16_t> frame = MakeFrame();
+    for (uint16_t e : { 0, 1, 5, 100, 0xFFFF }) {
+        DepthCodec codec(e);
+        vector<uint8_t> packet;
+        codec.EncodePacket(frame.data(), kWidth, kHeight, 7, packet);
+        DepthPacketHeader header;
+        vector<uint16_t> decoded(frame.size());
+        bool ok = DepthCodec::DecodePacket(packet.data(), packet.size(), header, decoded.data());
+        int worst = 0;
+        for (size_t i = 0; i < frame.size(); i++) {
+            worst = max(worst, abs(int(decoded[i]) - int(frame[i])));
+        }
+        Check(ok && header.sequence == 7 && worst <= e,
+            "round trip within max_error " + to_string(e));
+    }
+}
+
+void SetMaxError(vector<uint8_t> &packet, uint16_t max_error) {
+    packet[6] = uint8_t(max_error);
+    packet[7] = uint8_t(max_error >> 8);
+}
+
+void TestHostileMaxError() {
+    // Lossless residuals of a 0 <-> 0xFFFF checkerboard are the largest the
+    // coder emits; read back with the largest step they overflow 32 bits.
+    vector<uint16_t> frame(kWidth * kHeight);
+    for (size_t i = 0; i < frame.size(); i++) {
+        frame[i] = (i + i / kWidth) % 2 ? 0xFFFF : 0;
+    }
+    DepthCodec codec(0);
+    vector<uint8_t> packet;
+    codec.EncodePacket(frame.data(), kWidth, kHeight, 0, packet);
+    SetMaxError(packet, 0xFFFF);
+
+    DepthPacketHeader header;
+    vector<uint16_t> decoded(frame.size());
+    DepthCodec::DecodePacket(packet.data(), packet.size(), header, decoded.data());
+    Check(header.max_error == 0xFFFF, "max_error 0xFFFF over huge residuals decodes without overflow");
+}
+
+void TestMalformed() {
+    vector<uint16_t> frame = MakeFrame();
+    DepthCodec codec(2);
+    vector<uint8_t> packet;
+    codec.EncodePacket(frame.data(), kWidth, kHeight, 0, packet);
+    DepthPacketHeader header;
+    vector<uint16_t> decoded(frame.size());
+
+    Check(DepthCodec::ParsePacket(packet.data(), packet.size() - 1, header) == 0,
+        "a short packet needs more bytes");
+    Check(!DepthCodec::DecodePacket(packet.data(), packet.size() - 1, header, decoded.data()),
+        "a short packet is not decoded");
+
+    vector<uint8_t> bad_magic = packet;
+    bad_magic[0] ^= 1;
+    Check(DepthCodec::ParsePacket(bad_magic.data(), bad_magic.size(), header) == -1,
+        "a wrong magic is rejected");
+
+    vector<uint8_t> huge = packet;
+    huge[16] = huge[17] = huge[18] = huge[19] = 0xFF;
+    Check(DepthCodec::ParsePacket(huge.data(), huge.size(), header) == -1,
+        "a payload_size beyond the frame bound is rejected");
+
+    // A payload cut short but with a header claiming only what is there.
+    vector<uint8_t> cut(packet.begin(), packet.begin() + DepthCodec::kPacketHeaderSize + 16);
+    cut[16] = 16;
+    cut[17] = cut[18] = cut[19] = 0;
+    Check(!DepthCodec::DecodePacket(cut.data(), cut.size(), header, decoded.data()),
+        "a truncated payload is rejected");
+}
+
+void TestFuzz() {
+    vector<uint16_t> frame = MakeFrame();
+    vector<uint16_t> decoded(frame.size());
+    int rejected = 0;
+    const int kRounds = 2000;
+    for (int round = 0; round < kRounds; round++) {
+        DepthCodec codec(uint16_t(round % 3 == 0 ? 0 : rng() % 0x10000));
+        vector<uint8_t> packet;
+        codec.EncodePacket(frame.data(), kWidth, kHeight, uint32_t(round), packet);
+        // Flip payload bytes, and sometimes the header's max_error too.
+        int flips = 1 + int(rng() % 8);
+        for (int i = 0; i < flips; i++) {
+            size_t at = DepthCodec::kPacketHeaderSize +
+                rng() % (packet.size() - DepthCodec::kPacketHeaderSize);
+            packet[at] = uint8_t(rng());
+        }
+        if (round % 2) SetMaxError(packet, uint16_t(rng()));
+        DepthPacketHeader header;
+        if (!DepthCodec::DecodePacket(packet.data(), packet.size(), header, decoded.data())) {
+            rejected++;
+        }
+    }
+    Check(rejected > 0, "random corruption is decoded or rejected, " +
+        to_string(rejected) + " of " + to_string(kRounds) + " rejected");
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+    TestRoundTrip();
+    TestHostileMaxError();
+    TestMalformed();
+    TestFuzz();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "depth_confidence.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace mynteye;
+
+namespace {
+
+// Confidence by number of agreeing neighbours. An isolated valid pixel is
+// most likely a speckle.
+const std::uint8_t kConfidence[5] = { 16, 64, 128, 192, 255 };
+
+inline int Agrees(std::int32_t d, std::int32_t n, std::int32_t tolerance, std::int32_t ratio_q8) {
+    if (n == 0) return 0;
+    std::int32_t tol = std::max(tolerance, (d * ratio_q8) >> 8);
+    return std::abs(d - n) <= tol ? 1 : 0;
+}
+
+}  // namespace
+
+void mynteye::ComputeDepthConfidence(const cv::Mat &depth, cv::Mat &confidence,
+        const DepthConfidenceParams &params) {
+    if (depth.empty() || depth.type() != CV_16UC1) {
+        confidence.release();
+        return;
+    }
+    confidence.create(depth.rows, depth.cols, CV_8UC1);
+
+    const std::int32_t tolerance = params.tolerance;
+    const std::int32_t ratio_q8 = std::int32_t(params.tolerance_ratio * 256.f + 0.5f);
+    const int width = depth.cols;
+    for (int y = 0; y < depth.rows; y++) {
+        const std::uint16_t *row = depth.ptr<std::uint16_t>(y);
+        const std::uint16_t *up = y > 0 ? depth.ptr<std::uint16_t>(y - 1) : nullptr;
+        const std::uint16_t *down = y + 1 < depth.rows ? depth.ptr<std::uint16_t>(y + 1) : nullptr;
+        const int rows_inside = (up ? 1 : 0) + (down ? 1 : 0);
+        std::uint8_t *out = confidence.ptr<std::uint8_t>(y);
+        for (int x = 0; x < width; x++) {
+            std::int32_t d = row[x];
+            if (d == 0) {
+                out[x] = 0;
+                continue;
+            }
+            int agree = (x > 0 ? Agrees(d, row[x - 1], tolerance, ratio_q8) : 0) +
+                (x + 1 < width ? Agrees(d, row[x + 1], tolerance, ratio_q8) : 0) +
+                (up ? Agrees(d, up[x], tolerance, ratio_q8) : 0) +
+                (down ? Agrees(d, down[x], tolerance, ratio_q8) : 0);
+            // Border pixels score against the neighbours they have, so a
+            // fully supported one still reaches 255.
+            int inside = rows_inside + (x > 0 ? 1 : 0) + (x + 1 < width ? 1 : 0);
+            if (inside != 4) agree = inside ? agree * 4 / inside : 0;
+            out[x] = kConfidence[agree];
+        }
+    }
+}
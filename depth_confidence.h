@@ -0,0 +1,48 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_DEPTH_CONFIDENCE_H_
+#define MYNTEYE_API_DEPTH_CONFIDENCE_H_
+#pragma once
+
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+struct MYNTEYE_API DepthConfidenceParams {
+    /** Neighbours within max(tolerance, depth * tolerance_ratio) (mm) agree. */
+    std::uint16_t tolerance = 20;
+    float tolerance_ratio = 0.02f;
+};
+
+/**
+ * Fills confidence (CV_8UC1) from a CV_16UC1 depth frame.
+ *
+ * This is a proxy, not the matcher's confidence. It does not run or read
+ * the uniqueness, texture or left-right checks, which happen on the device,
+ * whose matcher costs are not sent. It is a separate pass over the finished
+ * frame, run only when asked for. A pixel scores by how many of its 4
+ * neighbours, fewer on the frame border, have a depth agreeing with it, so
+ * holes and speckles the device checks leave behind score low.
+ * Invalid pixels get 0, valid ones 16 to 255 by agreeing neighbours.
+ */
+MYNTEYE_API void ComputeDepthConfidence(const cv::Mat &depth, cv::Mat &confidence,
+    const DepthConfidenceParams &params = DepthConfidenceParams());
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_DEPTH_CONFIDENCE_H_
@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "depth_confidence.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: depth_confidence_test
+//
+// Runs ComputeDepthConfidence over synthetic frames: flat depth, a depth
+// step, invalid holes and isolated speckles, the tolerance bounds, random
+// depth for the output range, and input it must refuse.
+
+namespace {
+
+const int kWidth = 32;
+const int kHeight = 24;
+
+mt19937 rng(4);
+
+int failures = 0;
+
+void Check(bool ok, const string &what) {
+    cout << (ok ? "ok     " : "FAILED ") << what << endl;
+    if (!ok) failures++;
+}
+
+cv::Mat Flat(uint16_t d) {
+    cv::Mat depth(kHeight, kWidth, CV_16UC1);
+    for (int y = 0; y < kHeight; y++) {
+        for (int x = 0; x < kWidth; x++) depth.at<uint16_t>(y, x) = d;
+    }
+    return depth;
+}
+
+uint8_t At(const cv::Mat &confidence, int y, int x) {
+    return confidence.at<uint8_t>(y, x);
+}
+
+bool All(const cv::Mat &confidence, uint8_t value) {
+    for (int y = 0; y < confidence.rows; y++) {
+        for (int x = 0; x < confidence.cols; x++) {
+            if (At(confidence, y, x) != value) return false;
+        }
+    }
+    return true;
+}
+
+void TestFlat() {
+    cv::Mat confidence;
+    ComputeDepthConfidence(Flat(1500), confidence);
+    Check(confidence.type() == CV_8UC1 && confidence.rows == kHeight && confidence.cols == kWidth &&
+        All(confidence, 255), "flat depth is 255 everywhere, the border too");
+}
+
+void TestEdge() {
+    // 1 m left of the step, 3 m right of it.
+    const int step = kWidth / 2;
+    cv::Mat depth = Flat(1000);
+    for (int y = 0; y < kHeight; y++) {
+        for (int x = step; x < kWidth; x++) depth.at<uint16_t>(y, x) = 3000;
+    }
+    cv::Mat confidence;
+    ComputeDepthConfidence(depth, confidence);
+    bool ok = true;
+    for (int y = 1; y + 1 < kHeight; y++) {
+        ok = ok && At(confidence, y, step - 1) == 192 && At(confidence, y, step) == 192 &&
+            At(confidence, y, step - 2) == 255 && At(confidence, y, step + 1) == 255;
+    }
+    Check(ok, "pixels on a depth step lose the neighbour across it");
+    // 2 of 3 neighbours on the top row, scaled to 2 of 4.
+    Check(At(confidence, 0, step - 1) == 128 && At(confidence, 0, step) == 128,
+        "border pixels on the step score against the neighbours they have");
+}
+
+void TestInvalid() {
+    cv::Mat depth = Flat(2000);
+    depth.at<uint16_t>(5, 5) = 0;
+    // A speckle 40 cm off its surroundings.
+    depth.at<uint16_t>(10, 10) = 2400;
+    // A valid pixel alone among invalid ones.
+    for (int y = 14; y <= 18; y++) {
+        for (int x = 14; x <= 18; x++) depth.at<uint16_t>(y, x) = 0;
+    }
+    depth.at<uint16_t>(16, 16) = 2000;
+    cv::Mat confidence;
+    ComputeDepthConfidence(depth, confidence);
+    Check(At(confidence, 5, 5) == 0 && At(confidence, 15, 15) == 0, "invalid pixels are 0");
+    Check(At(confidence, 4, 5) == 192 && At(confidence, 5, 4) == 192 && At(confidence, 6, 5) == 192 &&
+        At(confidence, 5, 6) == 192, "an invalid neighbour does not agree");
+    Check(At(confidence, 10, 10) == 16 && At(confidence, 16, 16) == 16,
+        "speckles and isolated pixels are 16");
+}
+
+void TestTolerance() {
+    DepthConfidenceParams params;
+    params.tolerance = 20;
+    params.tolerance_ratio = 0.02f;
+    cv::Mat confidence;
+
+    // Near, the absolute tolerance holds.
+    cv::Mat depth = Flat(500);
+    depth.at<uint16_t>(8, 8) = 520;
+    depth.at<uint16_t>(8, 20) = 521;
+    ComputeDepthConfidence(depth, confidence, params);
+    Check(At(confidence, 8, 8) == 255 && At(confidence, 8, 20) == 16,
+        "near, neighbours within tolerance agree");
+
+    // Far, the ratio does, about 2% of 5000 rounded in steps of 1/256.
+    depth = Flat(5000);
+    depth.at<uint16_t>(8, 8) = 5090;
+    depth.at<uint16_t>(8, 20) = 5120;
+    ComputeDepthConfidence(depth, confidence, params);
+    Check(At(confidence, 8, 8) == 255 && At(confidence, 8, 20) == 16,
+        "far, neighbours within tolerance_ratio agree");
+}
+
+void TestRange() {
+    cv::Mat depth(kHeight, kWidth, CV_16UC1);
+    bool ok = true;
+    for (int round = 0; round < 50; round++) {
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                uint16_t d;
+                switch (rng() % 4) {
+                case 0: d = 0; break;
+                case 1: d = uint16_t(rng()); break;
+                default: d = uint16_t(1000 + rng() % 40); break;
+                }
+                depth.at<uint16_t>(y, x) = d;
+            }
+        }
+        cv::Mat confidence;
+        ComputeDepthConfidence(depth, confidence);
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                uint8_t c = At(confidence, y, x);
+                bool valid = depth.at<uint16_t>(y, x) != 0;
+                bool level = c == 16 || c == 64 || c == 128 || c == 192 || c == 255;
+                ok = ok && (valid ? level : c == 0);
+            }
+        }
+    }
+    Check(ok, "random depth gives 0 for invalid pixels, one of 16 to 255 for valid ones");
+}
+
+void TestRefused() {
+    cv::Mat confidence = Flat(1);
+    ComputeDepthConfidence(cv::Mat(), confidence);
+    bool ok = confidence.empty();
+    confidence = Flat(1);
+    ComputeDepthConfidence(cv::Mat(kHeight, kWidth, CV_8UC1), confidence);
+    Check(ok && confidence.empty(), "empty or non-CV_16UC1 depth leaves confidence empty");
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+    TestFlat();
+    TestEdge();
+    TestInvalid();
+    TestTolerance();
+    TestRange();
+    TestRefused();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,522 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "depth_shm.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#ifdef OS_WIN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "log.hpp"
+
+namespace mynteye {
+
+/** First cache line of the segment, written once by the publisher. */
+struct DepthShmHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t slot_count;
+    /** Process id of the publisher, to tell a live segment from a stale one. */
+    std::uint32_t owner_pid;
+    std::uint64_t slot_stride;
+    std::uint64_t segment_size;
+    /** Id of the newest complete frame, 0 before the first publish. */
+    std::atomic<std::uint64_t> latest;
+    /** Set once no more frames come: the publisher closed or was replaced. */
+    std::atomic<std::uint32_t> closed;
+};
+
+/** Frame metadata; the depth data follows at kSlotDataOffset. */
+struct DepthShmSlot {
+    /** Seqlock counter, odd while the publisher is writing the slot. */
+    std::atomic<std::uint32_t> seq;
+    std::uint32_t reserved;
+    std::uint64_t frame_id;
+    std::int64_t timestamp;
+};
+
+}  // namespace mynteye
+
+using namespace mynteye;
+
+namespace {
+
+const std::uint32_t kShmMagic = 0x4D53594D;  // "MYSM"
+const std::uint32_t kShmVersion = 2;
+const std::size_t kCacheLine = 64;
+const std::size_t kHeaderSize = kCacheLine;
+const std::size_t kSlotDataOffset = kCacheLine;
+// Bounded retries while the publisher keeps overwriting the slot being read.
+const int kMaxReadRetries = 16;
+
+static_assert(sizeof(DepthShmHeader) <= kHeaderSize, "header exceeds its cache line");
+static_assert(sizeof(DepthShmSlot) <= kSlotDataOffset, "slot metadata exceeds its cache line");
+// The atomics live in memory shared between processes, so they must not
+// fall back to a lock private to one process. std::uint64_t is long or
+// long long depending on the data model.
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2 &&
+    ATOMIC_LLONG_LOCK_FREE == 2, "seqlock atomics are not always lock-free");
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+    sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t),
+    "atomics in the shared layout carry extra state");
+
+inline std::size_t AlignUp(std::size_t v, std::size_t align) {
+    return (v + align - 1) / align * align;
+}
+
+inline const unsigned char *SlotData(const DepthShmSlot *slot) {
+    return reinterpret_cast<const unsigned char *>(slot) + kSlotDataOffset;
+}
+
+inline DepthShmSlot *SlotAt(DepthShmHeader *header, std::uint64_t frame_id) {
+    std::size_t index = std::size_t(frame_id % std::uint64_t(header->slot_count));
+    return reinterpret_cast<DepthShmSlot *>(
+        reinterpret_cast<unsigned char *>(header) + kHeaderSize + index * header->slot_stride);
+}
+
+inline std::int64_t NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifndef OS_WIN
+std::string PosixShmName(const std::string &name) {
+    return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+#endif
+
+std::uint32_t CurrentProcessId() {
+#ifdef OS_WIN
+    return std::uint32_t(GetCurrentProcessId());
+#else
+    return std::uint32_t(getpid());
+#endif
+}
+
+/** False only if the process is known to be gone; a recycled pid counts as alive. */
+bool IsProcessAlive(std::uint32_t pid) {
+#ifdef OS_WIN
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+    if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+    DWORD code = 0;
+    bool alive = GetExitCodeProcess(process, &code) && code == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    return pid != 0 && (kill(pid_t(pid), 0) == 0 || errno == EPERM);
+#endif
+}
+
+inline bool IsDepthHeader(const DepthShmRegion &region) {
+    const DepthShmHeader *header = static_cast<const DepthShmHeader *>(region.data());
+    return region.size() >= kHeaderSize && header->magic == kShmMagic &&
+        header->version == kShmVersion;
+}
+
+/**
+ * Removes a segment named name left behind by a publisher that is gone,
+ * after marking it closed for the subscribers still mapping it. Fails if
+ * its publisher is still running.
+ */
+bool ReclaimStaleSegment(const std::string &name) {
+    DepthShmRegion stale;
+    if (!stale.Open(name, true)) return false;
+    if (IsDepthHeader(stale)) {
+        DepthShmHeader *header = static_cast<DepthShmHeader *>(stale.data());
+        if (!header->closed.load(std::memory_order_acquire) && IsProcessAlive(header->owner_pid)) {
+            LOGE("Error: Shared memory %s is in use by process %u", name.c_str(), header->owner_pid);
+            return false;
+        }
+        header->closed.store(1, std::memory_order_release);
+    }
+    else {
+        LOGW("-- Shared memory %s is not a current depth stream, replaced", name.c_str());
+    }
+    stale.Close();
+    return DepthShmRegion::Unlink(name);
+}
+
+}  // namespace
+
+DepthShmRegion::DepthShmRegion() : data_(nullptr), size_(0), owner_(false)
+#ifdef OS_WIN
+    , handle_(nullptr)
+#endif
+{
+}
+
+DepthShmRegion::~DepthShmRegion() {
+    Close();
+}
+
+bool DepthShmRegion::Create(const std::string &name, std::size_t size) {
+    Close();
+#ifdef OS_WIN
+    HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        DWORD(std::uint64_t(size) >> 32), DWORD(size & 0xFFFFFFFF), name.c_str());
+    if (!handle) return false;
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(handle);
+        return false;
+    }
+    void *data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!data) {
+        CloseHandle(handle);
+        return false;
+    }
+    handle_ = handle;
+#else
+    std::string shm_name = PosixShmName(name);
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, off_t(size)) != 0) {
+        close(fd);
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+    void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+#endif
+    name_ = name;
+    data_ = data;
+    size_ = size;
+    owner_ = true;
+    return true;
+}
+
+bool DepthShmRegion::Open(const std::string &name, bool writable) {
+    Close();
+#ifdef OS_WIN
+    DWORD access = writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ;
+    HANDLE handle = OpenFileMappingA(access, FALSE, name.c_str());
+    if (!handle) return false;
+    void *data = MapViewOfFile(handle, access, 0, 0, 0);
+    if (!data) {
+        CloseHandle(handle);
+        return false;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(data, &info, sizeof(info));
+    handle_ = handle;
+    std::size_t size = info.RegionSize;
+#else
+    int fd = shm_open(PosixShmName(name).c_str(), writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    std::size_t size = std::size_t(st.st_size);
+    void *data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+        MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+#endif
+    name_ = name;
+    data_ = data;
+    size_ = size;
+    owner_ = false;
+    return true;
+}
+
+void DepthShmRegion::Close() {
+    if (!data_) return;
+#ifdef OS_WIN
+    UnmapViewOfFile(data_);
+    CloseHandle(handle_);
+    handle_ = nullptr;
+#else
+    munmap(data_, size_);
+    if (owner_) shm_unlink(PosixShmName(name_).c_str());
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    owner_ = false;
+    name_.clear();
+}
+
+bool DepthShmRegion::Unlink(const std::string &name) {
+#ifdef OS_WIN
+    // A file mapping lives as long as any process has it open.
+    unused(name);
+    return false;
+#else
+    return shm_unlink(PosixShmName(name).c_str()) == 0 || errno == ENOENT;
+#endif
+}
+
+DepthPublisher::DepthPublisher() : header_(nullptr), frame_id_(0) {
+}
+
+DepthPublisher::~DepthPublisher() {
+    Close();
+}
+
+ErrorCode DepthPublisher::Create(const std::string &name, std::int32_t width,
+        std::int32_t height, std::int32_t slot_count) {
+    Close();
+    if (width <= 0 || height <= 0 || slot_count < 2) {
+        LOGE("Error: Invalid depth publisher size %dx%d, %d slots", width, height, slot_count);
+        return ErrorCode::ERROR_FAILURE;
+    }
+
+    std::size_t slot_stride = AlignUp(kSlotDataOffset + std::size_t(width) * height * 2, kCacheLine);
+    std::size_t segment_size = kHeaderSize + slot_stride * std::size_t(slot_count);
+    // A segment of the same name either belongs to a running publisher,
+    // which is an error, or was left behind by one that died.
+    if (!region_.Create(name, segment_size) &&
+            (!ReclaimStaleSegment(name) || !region_.Create(name, segment_size))) {
+        LOGE("Error: Create shared memory %s failed", name.c_str());
+        return ErrorCode::ERROR_FAILURE;
+    }
+
+    unsigned char *base = static_cast<unsigned char *>(region_.data());
+    header_ = new (base) DepthShmHeader();
+    header_->width = width;
+    header_->height = height;
+    header_->slot_count = slot_count;
+    header_->owner_pid = CurrentProcessId();
+    header_->slot_stride = slot_stride;
+    header_->segment_size = segment_size;
+    header_->latest.store(0, std::memory_order_relaxed);
+    header_->closed.store(0, std::memory_order_relaxed);
+    for (std::int32_t i = 0; i < slot_count; i++) {
+        DepthShmSlot *slot = new (base + kHeaderSize + i * slot_stride) DepthShmSlot();
+        slot->seq.store(0, std::memory_order_relaxed);
+        slot->frame_id = 0;
+        slot->timestamp = 0;
+    }
+    header_->version = kShmVersion;
+    // Subscribers check the magic last, so it marks the header as complete.
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kShmMagic;
+
+    frame_id_ = 0;
+    LOGI("-- Depth publisher: %s, %dx%d, %d slots", name.c_str(), width, height, slot_count);
+    return ErrorCode::SUCCESS;
+}
+
+bool DepthPublisher::IsCreated() {
+    return header_ != nullptr;
+}
+
+void DepthPublisher::Publish(const unsigned char *depth) {
+    if (!header_) return;
+    std::uint64_t frame_id = ++frame_id_;
+    DepthShmSlot *slot = SlotAt(header_, frame_id);
+
+    std::uint32_t seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->frame_id = frame_id;
+    slot->timestamp = NowNanoseconds();
+    memcpy(reinterpret_cast<unsigned char *>(slot) + kSlotDataOffset, depth,
+        std::size_t(header_->width) * header_->height * 2);
+
+    slot->seq.store(seq + 2, std::memory_order_release);
+    header_->latest.store(frame_id, std::memory_order_release);
+}
+
+void DepthPublisher::Close() {
+    if (header_) header_->closed.store(1, std::memory_order_release);
+    header_ = nullptr;
+    region_.Close();
+}
+
+DepthSubscriber::DepthSubscriber()
+    : header_(nullptr), slot_(nullptr), slot_seq_(0), frame_id_(0), timestamp_(0), depth_min(0) {
+}
+
+DepthSubscriber::~DepthSubscriber() {
+    Close();
+}
+
+ErrorCode DepthSubscriber::Open(const std::string &name) {
+    Close();
+    if (!region_.Open(name)) {
+        LOGE("Error: Open shared memory %s failed", name.c_str());
+        return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+    }
+
+    const DepthShmHeader *header = static_cast<const DepthShmHeader *>(region_.data());
+    bool ok = region_.size() >= kHeaderSize && header->magic == kShmMagic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ok = ok && header->version == kShmVersion && header->segment_size <= region_.size();
+    if (!ok) {
+        LOGE("Error: Shared memory %s is not a depth stream", name.c_str());
+        region_.Close();
+        return ErrorCode::ERROR_CAMERA_OPEN_FAILED;
+    }
+    header_ = header;
+    return ErrorCode::SUCCESS;
+}
+
+bool DepthSubscriber::IsOpened() {
+    return header_ != nullptr;
+}
+
+bool DepthSubscriber::IsPublisherClosed() {
+    return header_ && header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+const DepthShmSlot *DepthSubscriber::AcquireLatest(std::uint32_t *seq) {
+    for (int i = 0; i < kMaxReadRetries; i++) {
+        std::uint64_t latest = header_->latest.load(std::memory_order_acquire);
+        if (latest == 0) return nullptr;
+        const DepthShmSlot *slot = SlotAt(const_cast<DepthShmHeader *>(header_), latest);
+        std::uint32_t s = slot->seq.load(std::memory_order_acquire);
+        if ((s & 1) == 0 && slot->frame_id == latest) {
+            *seq = s;
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+ErrorCode DepthSubscriber::RetrieveDepth() {
+    if (!IsOpened() || IsPublisherClosed()) return ErrorCode::ERROR_CAMERA_NOT_OPENED;
+
+    unsigned int point_x = (unsigned int)(header_->width) >> 1;
+    unsigned int point_y = (unsigned int)(header_->height) >> 1;
+    std::size_t index = (point_y * (unsigned int)(header_->width) + point_x) * 2;
+
+    for (int i = 0; i < kMaxReadRetries; i++) {
+        std::uint32_t seq;
+        const DepthShmSlot *slot = AcquireLatest(&seq);
+        if (!slot) return ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
+
+        const unsigned char *data = SlotData(slot);
+        ushort depth = ushort(data[index + 1]) << 8;
+        depth += ushort(data[index]);
+        std::uint64_t frame_id = slot->frame_id;
+        std::int64_t timestamp = slot->timestamp;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->seq.load(std::memory_order_relaxed) == seq) {
+            depth_min = depth;
+            frame_id_ = frame_id;
+            timestamp_ = timestamp;
+            return ErrorCode::SUCCESS;
+        }
+    }
+    return ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
+}
+
+ushort DepthSubscriber::GetMinDepth() {
+    return depth_min;
+}
+
+ErrorCode DepthSubscriber::RetrieveDepthImage(cv::Mat &depth) {
+    if (!IsOpened() || IsPublisherClosed()) return ErrorCode::ERROR_CAMERA_NOT_OPENED;
+
+    std::uint32_t seq;
+    const DepthShmSlot *slot = AcquireLatest(&seq);
+    if (!slot) return ErrorCode::ERROR_CAMERA_RETRIEVE_FAILED;
+
+    slot_ = slot;
+    slot_seq_ = seq;
+    frame_id_ = slot->frame_id;
+    timestamp_ = slot->timestamp;
+    depth = cv::Mat(header_->height, header_->width, CV_16UC1,
+        const_cast<unsigned char *>(SlotData(slot)));
+    return ErrorCode::SUCCESS;
+}
+
+bool DepthSubscriber::IsFrameValid() {
+    if (!slot_) return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot_->seq.load(std::memory_order_relaxed) == slot_seq_;
+}
+
+std::uint64_t DepthSubscriber::GetFrameId() {
+    return frame_id_;
+}
+
+std::int64_t DepthSubscriber::GetTimestamp() {
+    return timestamp_;
+}
+
+void DepthSubscriber::Close() {
+    header_ = nullptr;
+    slot_ = nullptr;
+    region_.Close();
+}
+
+DepthReplaySource::DepthReplaySource() : loop_(true) {
+}
+
+DepthReplaySource::~DepthReplaySource() {
+    Close();
+}
+
+bool DepthReplaySource::Open(const std::string &path, std::int32_t width,
+        std::int32_t height, bool loop) {
+    Close();
+    if (width <= 0 || height <= 0) return false;
+    in_.open(path, std::ios::binary);
+    if (!in_) {
+        LOGE("Error: Open replay file %s failed", path.c_str());
+        return false;
+    }
+    frame_.resize(std::size_t(width) * height * 2);
+    loop_ = loop;
+    if (!Next()) {
+        LOGE("Error: No complete %dx%d frame in %s", width, height, path.c_str());
+        Close();
+        return false;
+    }
+    in_.clear();
+    in_.seekg(0);
+    return true;
+}
+
+bool DepthReplaySource::IsOpened() {
+    return in_.is_open();
+}
+
+const unsigned char *DepthReplaySource::Next() {
+    if (!in_.is_open()) return nullptr;
+    char *data = reinterpret_cast<char *>(frame_.data());
+    if (in_.read(data, std::streamsize(frame_.size()))) return frame_.data();
+    if (!loop_) return nullptr;
+    // Rewind, a trailing partial frame is dropped.
+    in_.clear();
+    in_.seekg(0);
+    return in_.read(data, std::streamsize(frame_.size())) ? frame_.data() : nullptr;
+}
+
+void DepthReplaySource::Close() {
+    if (in_.is_open()) in_.close();
+    in_.clear();
+    frame_.clear();
+}
@@ -0,0 +1,167 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_DEPTH_SHM_H_
+#define MYNTEYE_API_DEPTH_SHM_H_
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+struct DepthShmHeader;
+struct DepthShmSlot;
+
+/** Maps a named shared-memory segment, POSIX shm or a Windows file mapping. */
+class DepthShmRegion {
+public:
+    DepthShmRegion();
+    ~DepthShmRegion();
+
+    /** Fails if a segment of that name exists already. */
+    bool Create(const std::string &name, std::size_t size);
+    bool Open(const std::string &name, bool writable = false);
+    void Close();
+
+    /** Removes the name, mappings stay valid until closed. POSIX only. */
+    static bool Unlink(const std::string &name);
+
+    void *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    DepthShmRegion(const DepthShmRegion &) = delete;
+    DepthShmRegion &operator=(const DepthShmRegion &) = delete;
+
+    std::string name_;
+    void *data_;
+    std::size_t size_;
+    bool owner_;
+#ifdef OS_WIN
+    void *handle_;
+#endif
+};
+
+/**
+ * Publishes depth frames into a ring of seqlock-protected slots in shared
+ * memory. Owned by the one process that has the device open.
+ *
+ * Create fails while another running publisher owns the name. A segment
+ * left by a publisher that died is marked closed and replaced.
+ */
+class MYNTEYE_API DepthPublisher {
+public:
+    DepthPublisher();
+    ~DepthPublisher();
+
+    ErrorCode Create(const std::string &name, std::int32_t width, std::int32_t height,
+        std::int32_t slot_count = 4);
+    bool IsCreated();
+
+    /** Copies one raw 16-bit depth frame of the created size into the ring. */
+    void Publish(const unsigned char *depth);
+
+    void Close();
+
+private:
+    DepthShmRegion region_;
+    DepthShmHeader *header_;
+    std::uint64_t frame_id_;
+};
+
+/**
+ * Reads frames published by DepthPublisher, with the same frame API as
+ * Camera. Frames are returned as views into the shared slot, not copies.
+ * Once the publisher closes or is replaced, Retrieve* return
+ * ERROR_CAMERA_NOT_OPENED; Open again to follow a new publisher.
+ */
+class MYNTEYE_API DepthSubscriber {
+public:
+    DepthSubscriber();
+    ~DepthSubscriber();
+
+    ErrorCode Open(const std::string &name);
+    bool IsOpened();
+    /** True once no more frames will be published to the opened segment. */
+    bool IsPublisherClosed();
+
+    ErrorCode RetrieveDepth();
+    ushort GetMinDepth();
+
+    /**
+     * Points depth at the latest slot without copying. The publisher may
+     * reuse the slot after slot_count newer frames; call IsFrameValid()
+     * after reading to know whether the view was overwritten meanwhile.
+     *
+     * The view is read-only: the segment is mapped without write access,
+     * so writing through depth crashes. Use depth.clone() to modify it.
+     */
+    ErrorCode RetrieveDepthImage(cv::Mat &depth);
+    bool IsFrameValid();
+
+    /** Id of the latest retrieved frame, increasing by one per publish. */
+    std::uint64_t GetFrameId();
+    /** Publish time of the latest retrieved frame, steady clock nanoseconds. */
+    std::int64_t GetTimestamp();
+
+    void Close();
+
+private:
+    const DepthShmSlot *AcquireLatest(std::uint32_t *seq);
+
+    DepthShmRegion region_;
+    const DepthShmHeader *header_;
+
+    const DepthShmSlot *slot_;
+    std::uint32_t slot_seq_;
+    std::uint64_t frame_id_;
+    std::int64_t timestamp_;
+    ushort depth_min;
+};
+
+/**
+ * Reads back-to-back raw 16-bit depth frames from a file, e.g. the
+ * CV_16UC1 mats from Camera::RetrieveDepthImage, to feed a DepthPublisher
+ * without the camera.
+ */
+class MYNTEYE_API DepthReplaySource {
+public:
+    DepthReplaySource();
+    ~DepthReplaySource();
+
+    /** Fails if the file does not hold at least one complete frame. */
+    bool Open(const std::string &path, std::int32_t width, std::int32_t height, bool loop = true);
+    bool IsOpened();
+
+    /** The next frame, valid until the next call; nullptr at the end unless looping. */
+    const unsigned char *Next();
+
+    void Close();
+
+private:
+    std::ifstream in_;
+    std::vector<unsigned char> frame_;
+    bool loop_;
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_DEPTH_SHM_H_
@@ -0,0 +1,47 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "depth_shm.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: depth_shm_replay <name> <frames.raw> <width> <height> [fps] [frames]
+//
+// Publishes a recorded raw depth file (see depth_codec_bench) under name,
+// looping, so DepthSubscriber clients can be run without the camera. Stops
+// after the given number of frames, 0 runs until killed.
+int main(int argc, char const *argv[]) {
+    if (argc < 5) {
+        cerr << "Usage: " << argv[0] << " <name> <frames.raw> <width> <height> [fps] [frames]" << endl;
+        return 1;
+    }
+    int width = atoi(argv[3]);
+    int height = atoi(argv[4]);
+    int fps = argc > 5 ? atoi(argv[5]) : 30;
+    long frames = argc > 6 ? atol(argv[6]) : 0;
+    if (width <= 0 || height <= 0 || fps <= 0 || frames < 0) {
+        cerr << "Error: Invalid frame size, fps or frame count" << endl;
+        return 1;
+    }
+
+    DepthReplaySource source;
+    if (!source.Open(argv[2], width, height)) return 1;
+
+    DepthPublisher publisher;
+    if (publisher.Create(argv[1], width, height) != ErrorCode::SUCCESS) return 1;
+
+    typedef chrono::steady_clock clock;
+    clock::duration period = chrono::microseconds(1000000 / fps);
+    clock::time_point next = clock::now();
+    for (long i = 0; frames == 0 || i < frames; i++) {
+        publisher.Publish(source.Next());
+        next += period;
+        this_thread::sleep_until(next);
+    }
+
+    publisher.Close();
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "depth_shm.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: depth_shm_test
+//
+// Replays a generated raw file through a DepthPublisher to several
+// subscriber processes. Every frame of the file is a ramp starting at a
+// per-frame seed, so a subscriber can tell from any copy whether it belongs
+// to the frame id it was returned with and whether it was torn. Also checks
+// that a live publisher's name cannot be taken and a dead one's can. POSIX.
+
+namespace {
+
+const int kWidth = 160;
+const int kHeight = 120;
+const int kFileFrames = 16;
+const int kPublishFrames = 3000;
+const int kSubscribers = 3;
+const int kSlots = 2;
+
+uint16_t Seed(uint64_t file_frame) {
+    return uint16_t(file_frame * 4099 + 1);
+}
+
+uint16_t SeedOf(uint64_t frame_id) {
+    return Seed((frame_id - 1) % kFileFrames);
+}
+
+bool WriteReplayFile(const string &path) {
+    ofstream out(path, ios::binary | ios::trunc);
+    vector<uint16_t> frame(kWidth * kHeight);
+    for (int i = 0; i < kFileFrames; i++) {
+        for (size_t k = 0; k < frame.size(); k++) {
+            frame[k] = uint16_t(Seed(i) + k);
+        }
+        out.write(reinterpret_cast<const char *>(frame.data()), frame.size() * 2);
+    }
+    return static_cast<bool>(out);
+}
+
+/** Runs in a child process, returns the exit status. */
+int RunSubscriber(const string &name, int index) {
+    DepthSubscriber subscriber;
+    if (subscriber.Open(name) != ErrorCode::SUCCESS) return 2;
+
+    const size_t center = (kHeight / 2) * kWidth + kWidth / 2;
+    vector<uint16_t> copy(kWidth * kHeight);
+    uint64_t last_id = 0;
+    long frames = 0, overwritten = 0, torn = 0, mismatched = 0, backwards = 0;
+    typedef chrono::steady_clock clock;
+    clock::time_point deadline = clock::now() + chrono::seconds(30);
+    while (!subscriber.IsPublisherClosed() && clock::now() < deadline) {
+        if (subscriber.RetrieveDepth() == ErrorCode::SUCCESS) {
+            uint64_t id = subscriber.GetFrameId();
+            if (subscriber.GetMinDepth() != uint16_t(SeedOf(id) + center)) mismatched++;
+        }
+
+        cv::Mat view;
+        if (subscriber.RetrieveDepthImage(view) != ErrorCode::SUCCESS) {
+            this_thread::sleep_for(chrono::microseconds(50));
+            continue;
+        }
+        uint64_t id = subscriber.GetFrameId();
+        if (id < last_id) backwards++;
+        const uint16_t *data = view.ptr<uint16_t>();
+        copy.assign(data, data + copy.size());
+        if (!subscriber.IsFrameValid()) {
+            overwritten++;
+            continue;
+        }
+        if (id != last_id) frames++;
+        last_id = id;
+        if (copy[0] != SeedOf(id)) mismatched++;
+        for (size_t k = 1; k < copy.size(); k++) {
+            if (copy[k] != uint16_t(copy[0] + k)) {
+                torn++;
+                break;
+            }
+        }
+    }
+
+    cout << "subscriber " << index << ": " << frames << " frames, last id " << last_id
+         << ", overwritten " << overwritten << ", torn " << torn << ", id mismatch "
+         << mismatched << ", backwards " << backwards << endl;
+    bool ok = frames > 0 && torn == 0 && mismatched == 0 && backwards == 0 &&
+        subscriber.IsPublisherClosed();
+    return ok ? 0 : 1;
+}
+
+bool TestReplay(const string &name, const string &path) {
+    DepthReplaySource source;
+    DepthPublisher publisher;
+    if (!source.Open(path, kWidth, kHeight) ||
+            publisher.Create(name, kWidth, kHeight, kSlots) != ErrorCode::SUCCESS) {
+        cerr << "Error: Create replay publisher failed" << endl;
+        return false;
+    }
+
+    vector<pid_t> children;
+    for (int i = 0; i < kSubscribers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int status = RunSubscriber(name, i);
+            cout.flush();
+            _exit(status);
+        }
+        children.push_back(pid);
+    }
+
+    // A few slots and no pacing, so readers race the writer constantly.
+    this_thread::sleep_for(chrono::milliseconds(50));
+    for (int i = 0; i < kPublishFrames; i++) {
+        publisher.Publish(source.Next());
+        if (i % 8 == 0) this_thread::sleep_for(chrono::microseconds(100));
+    }
+    publisher.Close();
+
+    bool ok = true;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return ok;
+}
+
+bool TestLiveName(const string &name) {
+    DepthPublisher first, second;
+    if (first.Create(name, kWidth, kHeight) != ErrorCode::SUCCESS) return false;
+    // Logs an error, expected.
+    return second.Create(name, kWidth, kHeight) != ErrorCode::SUCCESS;
+}
+
+bool TestStaleName(const string &name) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Dies without closing, the segment stays behind.
+        DepthPublisher publisher;
+        vector<uint8_t> frame(kWidth * kHeight * 2);
+        bool ok = publisher.Create(name, kWidth, kHeight) == ErrorCode::SUCCESS;
+        if (ok) publisher.Publish(frame.data());
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+
+    DepthSubscriber old_subscriber;
+    if (old_subscriber.Open(name) != ErrorCode::SUCCESS ||
+            old_subscriber.RetrieveDepth() != ErrorCode::SUCCESS) {
+        return false;
+    }
+
+    DepthPublisher publisher;
+    if (publisher.Create(name, kWidth, kHeight) != ErrorCode::SUCCESS) return false;
+    // The orphaned mapping tells its readers, a new subscriber sees the new segment.
+    DepthSubscriber new_subscriber;
+    return old_subscriber.RetrieveDepth() == ErrorCode::ERROR_CAMERA_NOT_OPENED &&
+        new_subscriber.Open(name) == ErrorCode::SUCCESS &&
+        !new_subscriber.IsPublisherClosed();
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+    string suffix = to_string(getpid());
+    string path = "depth_shm_test_" + suffix + ".raw";
+    if (!WriteReplayFile(path)) {
+        cerr << "Error: Write " << path << " failed" << endl;
+        return 1;
+    }
+
+    bool replay = TestReplay("mynteye_test_replay_" + suffix, path);
+    bool live = TestLiveName("mynteye_test_live_" + suffix);
+    bool stale = TestStaleName("mynteye_test_stale_" + suffix);
+    remove(path.c_str());
+
+    cout << "Replay to " << kSubscribers << " subscribers : " << (replay ? "ok" : "FAILED") << endl;
+    cout << "Live name refused         : " << (live ? "ok" : "FAILED") << endl;
+    cout << "Stale name reclaimed      : " << (stale ? "ok" : "FAILED") << endl;
+    return replay && live && stale ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "device_cache.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "log.hpp"
+
+using namespace mynteye;
+
+namespace {
+
+const int kStreamInfoCount = 64;
+const char kCacheVersion[] = "mynteye-device-cache 2";
+
+void WriteStreamInfos(std::ostream &out, const char *key,
+        const std::vector<ETRONDI_STREAM_INFO> &infos) {
+    for (size_t i = 0; i < infos.size(); i++) {
+        if (infos[i].nWidth <= 0) continue;
+        out << key << " " << i << " " << infos[i].nWidth << " " << infos[i].nHeight
+            << " " << (infos[i].bFormatMJPG ? 1 : 0) << "\n";
+    }
+}
+
+bool ReadStreamInfo(std::istringstream &in, std::vector<ETRONDI_STREAM_INFO> &infos) {
+    int index, width, height, mjpg;
+    if (!(in >> index >> width >> height >> mjpg)) return false;
+    if (index < 0 || index >= kStreamInfoCount) return false;
+    if (infos.empty()) {
+        infos.resize(kStreamInfoCount);
+        memset(infos.data(), 0, sizeof(ETRONDI_STREAM_INFO) * kStreamInfoCount);
+    }
+    infos[index].nWidth = width;
+    infos[index].nHeight = height;
+    infos[index].bFormatMJPG = mjpg != 0;
+    return true;
+}
+
+}  // namespace
+
+DeviceCache::DeviceCache() : dirty_(false) {
+}
+
+DeviceCache::~DeviceCache() {
+    Save();
+}
+
+bool DeviceCache::SetPath(const std::string &path) {
+    Save();
+    path_ = path;
+    if (path_.empty()) return true;
+    return Load();
+}
+
+bool DeviceCache::Load() {
+    std::ifstream in(path_);
+    if (!in) return false;
+
+    std::string line;
+    if (!std::getline(in, line) || line != kCacheVersion) {
+        LOGW("-- Device cache %s: unknown format, ignored", path_.c_str());
+        return false;
+    }
+
+    std::map<std::string, DeviceDescriptor> descriptors;
+    DeviceDescriptor *desc = nullptr;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        bool ok = true;
+        if (key == "device") {
+            std::string serial_number;
+            ok = static_cast<bool>(fields >> serial_number);
+            if (ok) {
+                desc = &descriptors[serial_number];
+                desc->serial_number = serial_number;
+            }
+        }
+        else if (!desc) {
+            ok = key.empty();
+        }
+        else if (key == "path") {
+            desc->device_path = line.size() > 5 ? line.substr(5) : "";
+        }
+        else if (key == "fw") {
+            desc->fw_version = line.size() > 3 ? line.substr(3) : "";
+        }
+        else if (key == "color") {
+            ok = ReadStreamInfo(fields, desc->color_infos);
+        }
+        else if (key == "depth") {
+            ok = ReadStreamInfo(fields, desc->depth_infos);
+        }
+        if (!ok) {
+            LOGW("-- Device cache %s: bad line \"%s\", ignored", path_.c_str(), line.c_str());
+            return false;
+        }
+    }
+
+    descriptors_.swap(descriptors);
+    dirty_ = false;
+    DBG_LOGI("Device cache %s: %d devices", path_.c_str(), int(descriptors_.size()));
+    return true;
+}
+
+bool DeviceCache::Save() {
+    if (path_.empty() || !dirty_) return true;
+
+    std::ofstream out(path_, std::ios::trunc);
+    if (!out) {
+        LOGW("-- Device cache %s: write failed", path_.c_str());
+        return false;
+    }
+    out << kCacheVersion << "\n";
+    for (auto &&entry : descriptors_) {
+        const DeviceDescriptor &desc = entry.second;
+        out << "device " << desc.serial_number << "\n";
+        if (!desc.device_path.empty()) out << "path " << desc.device_path << "\n";
+        out << "fw " << desc.fw_version << "\n";
+        WriteStreamInfos(out, "color", desc.color_infos);
+        WriteStreamInfos(out, "depth", desc.depth_infos);
+    }
+    dirty_ = false;
+    return static_cast<bool>(out);
+}
+
+void DeviceCache::Clear() {
+    descriptors_.clear();
+    dirty_ = true;
+}
+
+DeviceDescriptor *DeviceCache::Find(const std::string &serial_number) {
+    auto it = descriptors_.find(serial_number);
+    return it == descriptors_.end() ? nullptr : &it->second;
+}
+
+DeviceDescriptor *DeviceCache::FindByDevicePath(const std::string &device_path) {
+    if (device_path.empty()) return nullptr;
+    for (auto &&entry : descriptors_) {
+        if (entry.second.device_path == device_path) return &entry.second;
+    }
+    return nullptr;
+}
+
+DeviceDescriptor &DeviceCache::Get(const std::string &serial_number) {
+    dirty_ = true;
+    DeviceDescriptor &desc = descriptors_[serial_number];
+    desc.serial_number = serial_number;
+    return desc;
+}
+
+DeviceDescriptor &DeviceCache::Bind(const std::string &serial_number,
+        const std::string &device_path) {
+    DeviceDescriptor *found = Find(serial_number);
+    if (found && found->device_path == device_path) return *found;
+    DeviceDescriptor &desc = Get(serial_number);
+    for (auto &&entry : descriptors_) {
+        if (entry.second.device_path == device_path) entry.second.device_path.clear();
+    }
+    desc.device_path = device_path;
+    return desc;
+}
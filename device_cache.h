@@ -0,0 +1,71 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_CORE_DEVICE_CACHE_H_
+#define MYNTEYE_CORE_DEVICE_CACHE_H_
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "eSPDI.h"
+
+namespace mynteye {
+
+/** What is slow to query from a device and does not change between runs. */
+struct DeviceDescriptor {
+    std::string serial_number;
+    /**
+     * Path the device was last enumerated at, known without device I/O.
+     * Another device may take it after hotplug, so it only picks the
+     * likely descriptor; the serial number is what identifies the device.
+     */
+    std::string device_path;
+    std::string fw_version;
+    /** Raw resolution lists, kept at the 64 entries the SDK fills. */
+    std::vector<ETRONDI_STREAM_INFO> color_infos;
+    std::vector<ETRONDI_STREAM_INFO> depth_infos;
+};
+
+/**
+ * Device descriptors keyed by serial number, optionally persisted to a
+ * text file. Delete the file after a firmware update.
+ */
+class DeviceCache {
+public:
+    DeviceCache();
+    ~DeviceCache();
+
+    /** Sets the backing file and loads it, an empty path keeps it in memory. */
+    bool SetPath(const std::string &path);
+    bool Save();
+    void Clear();
+
+    DeviceDescriptor *Find(const std::string &serial_number);
+    DeviceDescriptor *FindByDevicePath(const std::string &device_path);
+    DeviceDescriptor &Get(const std::string &serial_number);
+    /** Moves device_path to the descriptor of serial_number. */
+    DeviceDescriptor &Bind(const std::string &serial_number, const std::string &device_path);
+
+private:
+    bool Load();
+
+    std::string path_;
+    std::map<std::string, DeviceDescriptor> descriptors_;
+    bool dirty_;
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_CORE_DEVICE_CACHE_H_
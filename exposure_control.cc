@@ -0,0 +1,134 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "exposure_control.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "log.hpp"
+
+using namespace mynteye;
+
+void mynteye::ComputeDepthStatistics(const unsigned char *depth,
+        std::int32_t width, std::int32_t height, std::int32_t sample_step,
+        std::uint16_t max_depth, std::uint16_t near_depth, DepthStatistics &stats) {
+    stats = DepthStatistics();
+    if (!depth || width <= 0 || height <= 0 || max_depth == 0) return;
+    if (sample_step < 1) sample_step = 1;
+
+    for (std::int32_t y = sample_step >> 1; y < height; y += sample_step) {
+        const unsigned char *row = depth + std::size_t(y) * width * 2;
+        for (std::int32_t x = sample_step >> 1; x < width; x += sample_step) {
+            std::uint32_t d = std::uint32_t(row[x * 2]) | (std::uint32_t(row[x * 2 + 1]) << 8);
+            stats.sampled++;
+            if (d == 0 || d >= max_depth) continue;
+            stats.valid++;
+            if (d < near_depth) stats.near++;
+        }
+    }
+}
+
+ExposureController::ExposureController(RegisterBackend *backend,
+        const ExposureControlParams &params)
+    : backend_(backend), params_(params), ir_intensity_(-1), exposure_(-1),
+      frames_since_write_(0), observed_(false) {
+}
+
+ExposureController::~ExposureController() {
+}
+
+void ExposureController::Reset(std::int32_t ir_intensity) {
+    ir_intensity_ = ir_intensity;
+    exposure_ = -1;
+    if (params_.exposure_address) {
+        unsigned short value;
+        if (backend_->GetSensorRegister(params_.exposure_sensor_id, params_.exposure_address, &value)) {
+            exposure_ = value;
+        }
+        else {
+            LOGW("-- Read exposure register 0x%X failed", params_.exposure_address);
+        }
+    }
+    frames_since_write_ = 0;
+    observed_ = false;
+}
+
+void ExposureController::Observe(const unsigned char *depth,
+        std::int32_t width, std::int32_t height) {
+    ComputeDepthStatistics(depth, width, height, params_.sample_step, params_.max_depth,
+        params_.near_depth, stats_);
+    frames_since_write_++;
+    observed_ = true;
+}
+
+ExposureStep ExposureController::Decide() {
+    ExposureStep step;
+    if (!observed_) return step;
+    observed_ = false;
+    if (frames_since_write_ < params_.min_interval_frames) return step;
+    if (stats_.sampled == 0 || stats_.FillRate() >= params_.fill_target) return step;
+
+    // A large share of very near returns means the IR pattern saturates
+    // close surfaces, otherwise the scene is too dark or too far.
+    float near_ratio = stats_.valid ? float(stats_.near) / stats_.valid : 0.f;
+    int direction = near_ratio > params_.near_saturation ? -1 : 1;
+
+    step.fill_rate = stats_.FillRate();
+    if (ir_intensity_ >= 0) {
+        std::int32_t ir = std::min(std::max(ir_intensity_ + direction, params_.ir_min), params_.ir_max);
+        if (ir != ir_intensity_) {
+            step.reg = ExposureStep::IR;
+            step.address = params_.ir_address;
+            step.value = (unsigned short)ir;
+            ir_intensity_ = ir;
+            frames_since_write_ = 0;
+            return step;
+        }
+    }
+    if (exposure_ >= 0) {
+        std::int32_t exposure = std::min(std::max(exposure_ + direction * params_.exposure_step,
+            params_.exposure_min), params_.exposure_max);
+        if (exposure != exposure_) {
+            step.reg = ExposureStep::EXPOSURE;
+            step.sensor_id = params_.exposure_sensor_id;
+            step.address = params_.exposure_address;
+            step.value = (unsigned short)exposure;
+            exposure_ = exposure;
+            frames_since_write_ = 0;
+        }
+    }
+    return step;
+}
+
+bool ExposureController::Apply(RegisterBackend *backend, const ExposureStep &step) {
+    switch (step.reg) {
+    case ExposureStep::IR:
+        if (!backend->SetFWRegister(step.address, step.value)) {
+            LOGW("-- IR intensity: %d (failed)", step.value);
+            return false;
+        }
+        DBG_LOGI("-- IR intensity: %d, fill rate %.2f", step.value, step.fill_rate);
+        return true;
+    case ExposureStep::EXPOSURE:
+        if (!backend->SetSensorRegister(step.sensor_id, step.address, step.value)) {
+            LOGW("-- Exposure: %d (failed)", step.value);
+            return false;
+        }
+        DBG_LOGI("-- Exposure: %d, fill rate %.2f", step.value, step.fill_rate);
+        return true;
+    case ExposureStep::NONE:
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,139 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_EXPOSURE_CONTROL_H_
+#define MYNTEYE_API_EXPOSURE_CONTROL_H_
+#pragma once
+
+#include <cstdint>
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+/**
+ * Register access used by the exposure control loop. Implemented over the
+ * camera's Get/Set*Register helpers, or by a simulation in tests.
+ */
+class MYNTEYE_API RegisterBackend {
+public:
+    virtual ~RegisterBackend() {}
+
+    virtual bool GetSensorRegister(int id, unsigned short address, unsigned short *value) = 0;
+    virtual bool SetSensorRegister(int id, unsigned short address, unsigned short value) = 0;
+    virtual bool SetFWRegister(unsigned short address, unsigned short value) = 0;
+};
+
+struct MYNTEYE_API ExposureControlParams {
+    /** Below this valid-pixel ratio the loop steps IR or exposure. */
+    float fill_target = 0.6f;
+    /** Valid samples closer than near_depth (mm) above this ratio mean IR saturation. */
+    float near_saturation = 0.3f;
+    std::uint16_t near_depth = 300;
+    /** Samples at or beyond max_depth (mm) count as invalid. */
+    std::uint16_t max_depth = 10000;
+    /** Sample every sample_step-th pixel of every sample_step-th row. */
+    std::int32_t sample_step = 4;
+    /** Frames to wait after a register write before the next one. */
+    std::int32_t min_interval_frames = 15;
+
+    unsigned short ir_address = 0xE0;
+    std::int32_t ir_min = 0;
+    std::int32_t ir_max = 6;
+
+    /**
+     * Sensor exposure register, 0 leaves exposure alone. Auto-exposure
+     * should be disabled when this is set.
+     */
+    unsigned short exposure_address = 0;
+    int exposure_sensor_id = 0;
+    std::int32_t exposure_step = 16;
+    std::int32_t exposure_min = 0;
+    std::int32_t exposure_max = 0xFFFF;
+};
+
+struct MYNTEYE_API DepthStatistics {
+    std::uint32_t sampled = 0;
+    std::uint32_t valid = 0;
+    /** Valid samples closer than near_depth. */
+    std::uint32_t near = 0;
+
+    float FillRate() const { return sampled ? float(valid) / sampled : 0.f; }
+};
+
+/** Counts valid and near samples over a subsampled 16-bit frame. */
+MYNTEYE_API void ComputeDepthStatistics(const unsigned char *depth,
+    std::int32_t width, std::int32_t height, std::int32_t sample_step,
+    std::uint16_t max_depth, std::uint16_t near_depth, DepthStatistics &stats);
+
+/** One register write picked by ExposureController::Decide. */
+struct MYNTEYE_API ExposureStep {
+    enum Register {
+        NONE,
+        IR,
+        EXPOSURE
+    };
+
+    Register reg = NONE;
+    int sensor_id = 0;
+    unsigned short address = 0;
+    unsigned short value = 0;
+    /** Fill rate that triggered the step, for the log. */
+    float fill_rate = 0.f;
+};
+
+/**
+ * Steps IR intensity, then sensor exposure, when the depth fill rate drops
+ * below target. Observe() and Decide() are cheap and meant to run on every
+ * frame under the frame lock, which serializes them; the static Apply()
+ * does the register round trip outside of it and touches no controller
+ * state, so the controller may be destroyed meanwhile.
+ */
+class MYNTEYE_API ExposureController {
+public:
+    ExposureController(RegisterBackend *backend, const ExposureControlParams &params);
+    ~ExposureController();
+
+    /** Sets the IR intensity the device was opened with and reads exposure. */
+    void Reset(std::int32_t ir_intensity);
+
+    void Observe(const unsigned char *depth, std::int32_t width, std::int32_t height);
+    /**
+     * Picks at most one register write once min_interval_frames have
+     * passed, and takes its value as the new setting. A failed write is
+     * only logged, the next step goes on from the new setting.
+     */
+    ExposureStep Decide();
+    /** Writes the register of a step, true if one was written. */
+    static bool Apply(RegisterBackend *backend, const ExposureStep &step);
+    /** Decide and Apply in one, for callers without a frame lock. */
+    bool Apply() { return Apply(backend_, Decide()); }
+
+    const DepthStatistics &GetStatistics() const { return stats_; }
+    std::int32_t GetIRIntensity() const { return ir_intensity_; }
+    std::int32_t GetExposure() const { return exposure_; }
+
+private:
+    RegisterBackend *backend_;
+    ExposureControlParams params_;
+
+    DepthStatistics stats_;
+    std::int32_t ir_intensity_;
+    std::int32_t exposure_;
+    std::int32_t frames_since_write_;
+    bool observed_;
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_EXPOSURE_CONTROL_H_
@@ -0,0 +1,196 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "exposure_control.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: exposure_control_test
+//
+// Runs ExposureController against a simulated register backend, without
+// the camera, and checks which registers it writes for synthetic frames.
+
+namespace {
+
+const int kWidth = 64;
+const int kHeight = 48;
+
+class SimBackend : public RegisterBackend {
+public:
+    SimBackend() : ir(-1), exposure(0x100), ir_writes(0), exposure_writes(0) {}
+
+    bool GetSensorRegister(int id, unsigned short address, unsigned short *value) override {
+        (void)id;
+        (void)address;
+        *value = (unsigned short)exposure;
+        return true;
+    }
+
+    bool SetSensorRegister(int id, unsigned short address, unsigned short value) override {
+        (void)id;
+        (void)address;
+        exposure = value;
+        exposure_writes++;
+        return true;
+    }
+
+    bool SetFWRegister(unsigned short address, unsigned short value) override {
+        if (address != 0xE0) return false;
+        ir = value;
+        ir_writes++;
+        return true;
+    }
+
+    int ir;
+    int exposure;
+    int ir_writes;
+    int exposure_writes;
+};
+
+/** A frame with fill (0-1) of its pixels at depth mm, the rest invalid. */
+vector<unsigned char> MakeFrame(float fill, uint16_t depth) {
+    vector<unsigned char> frame(kWidth * kHeight * 2, 0);
+    int valid = int(fill * kWidth * kHeight);
+    for (int i = 0; i < kWidth * kHeight; i++) {
+        // Spread valid pixels evenly so subsampling sees the same ratio.
+        if ((long(i) * valid) / (kWidth * kHeight) == (long(i + 1) * valid) / (kWidth * kHeight)) continue;
+        frame[i * 2] = uint8_t(depth);
+        frame[i * 2 + 1] = uint8_t(depth >> 8);
+    }
+    return frame;
+}
+
+void Run(ExposureController &control, const vector<unsigned char> &frame, int frames) {
+    for (int i = 0; i < frames; i++) {
+        control.Observe(frame.data(), kWidth, kHeight);
+        control.Apply();
+    }
+}
+
+ExposureControlParams TestParams() {
+    ExposureControlParams params;
+    params.sample_step = 1;
+    params.min_interval_frames = 1;
+    return params;
+}
+
+int failures = 0;
+
+void Check(bool ok, const string &what) {
+    cout << (ok ? "ok     " : "FAILED ") << what << endl;
+    if (!ok) failures++;
+}
+
+void TestStatistics() {
+    vector<unsigned char> frame = MakeFrame(0.5f, 150);
+    DepthStatistics stats;
+    ComputeDepthStatistics(frame.data(), kWidth, kHeight, 1, 10000, 300, stats);
+    Check(stats.sampled == kWidth * kHeight && stats.valid == kWidth * kHeight / 2 &&
+        stats.near == stats.valid, "statistics count near samples below near_depth");
+}
+
+void TestStepUp() {
+    SimBackend backend;
+    ExposureController control(&backend, TestParams());
+    control.Reset(3);
+    Run(control, MakeFrame(0.2f, 3000), 1);
+    Check(backend.ir == 4 && control.GetIRIntensity() == 4, "low fill at range steps IR up");
+}
+
+void TestSaturationStepDown() {
+    SimBackend backend;
+    ExposureController control(&backend, TestParams());
+    control.Reset(3);
+    Run(control, MakeFrame(0.2f, 150), 2);
+    Check(backend.ir == 1 && backend.ir_writes == 2, "low fill close up steps IR down");
+}
+
+void TestFullFillHolds() {
+    SimBackend backend;
+    ExposureController control(&backend, TestParams());
+    control.Reset(3);
+    Run(control, MakeFrame(1.f, 3000), 10);
+    Check(backend.ir_writes == 0 && backend.exposure_writes == 0, "fill above target writes nothing");
+}
+
+void TestClamp() {
+    ExposureControlParams params = TestParams();
+    params.ir_min = 1;
+    params.ir_max = 5;
+
+    SimBackend up;
+    ExposureController control_up(&up, params);
+    control_up.Reset(3);
+    Run(control_up, MakeFrame(0.2f, 3000), 10);
+    Check(up.ir == 5 && up.ir_writes == 2, "IR stops at ir_max");
+
+    SimBackend down;
+    ExposureController control_down(&down, params);
+    control_down.Reset(3);
+    Run(control_down, MakeFrame(0.2f, 150), 10);
+    Check(down.ir == 1 && down.ir_writes == 2, "IR stops at ir_min");
+}
+
+void TestExposureAfterIR() {
+    ExposureControlParams params = TestParams();
+    params.exposure_address = 0x3012;
+    params.exposure_step = 16;
+    params.exposure_max = 0x120;
+
+    SimBackend backend;
+    ExposureController control(&backend, params);
+    control.Reset(5);
+    Run(control, MakeFrame(0.2f, 3000), 10);
+    Check(backend.ir == 6 && backend.exposure == 0x120 && backend.exposure_writes == 2,
+        "exposure steps once IR is at ir_max, up to exposure_max");
+}
+
+void TestRateLimit() {
+    ExposureControlParams params = TestParams();
+    params.min_interval_frames = 15;
+
+    SimBackend backend;
+    ExposureController control(&backend, params);
+    control.Reset(0);
+    Run(control, MakeFrame(0.2f, 3000), 14);
+    bool none_early = backend.ir_writes == 0;
+    Run(control, MakeFrame(0.2f, 3000), 1);
+    bool first = backend.ir_writes == 1;
+    Run(control, MakeFrame(0.2f, 3000), 14);
+    bool none_between = backend.ir_writes == 1;
+    Run(control, MakeFrame(0.2f, 3000), 1);
+    Check(none_early && first && none_between && backend.ir_writes == 2,
+        "writes are min_interval_frames apart");
+}
+
+void TestDecideWithoutController() {
+    SimBackend backend;
+    ExposureStep step;
+    {
+        ExposureController control(&backend, TestParams());
+        control.Reset(3);
+        vector<unsigned char> frame = MakeFrame(0.2f, 3000);
+        control.Observe(frame.data(), kWidth, kHeight);
+        step = control.Decide();
+    }
+    // The controller is gone, as after DisableExposureControl.
+    Check(ExposureController::Apply(&backend, step) && backend.ir == 4,
+        "a decided step applies after the controller is destroyed");
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+    TestStatistics();
+    TestStepUp();
+    TestSaturationStepDown();
+    TestFullFillHolds();
+    TestClamp();
+    TestExposureAfterIR();
+    TestRateLimit();
+    TestDecideWithoutController();
+    return failures ? 1 : 0;
+}
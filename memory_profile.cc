@@ -0,0 +1,72 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "memory_profile.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef OS_WIN
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace mynteye;
+
+FrameArena::FrameArena() : data_(nullptr), capacity_(0), used_(0) {
+}
+
+FrameArena::~FrameArena() {
+    free(data_);
+}
+
+bool FrameArena::Reserve(std::size_t capacity) {
+    used_ = 0;
+    if (capacity <= capacity_) return true;
+    free(data_);
+    data_ = static_cast<unsigned char *>(malloc(capacity));
+    capacity_ = data_ ? capacity : 0;
+    return data_ != nullptr;
+}
+
+void *FrameArena::Allocate(std::size_t size, std::size_t align) {
+    if (!data_) return nullptr;
+    std::size_t base = reinterpret_cast<std::size_t>(data_);
+    std::size_t offset = (base + used_ + align - 1) / align * align - base;
+    if (offset > capacity_ || size > capacity_ - offset) return nullptr;
+    used_ = offset + size;
+    memset(data_ + offset, 0, size);
+    return data_ + offset;
+}
+
+void FrameArena::Reset() {
+    used_ = 0;
+}
+
+std::size_t mynteye::GetPeakResidentSize() {
+#ifdef OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return std::size_t(usage.ru_maxrss);
+#else
+    return std::size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
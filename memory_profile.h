@@ -0,0 +1,58 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_MEMORY_PROFILE_H_
+#define MYNTEYE_API_MEMORY_PROFILE_H_
+#pragma once
+
+#include <cstddef>
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+/**
+ * Bump allocator over one heap block. Buffers for a resolution are carved
+ * from it at Open and released together, so long runs do not fragment the
+ * heap. The block is only reallocated when a larger capacity is reserved.
+ */
+class MYNTEYE_API FrameArena {
+public:
+    FrameArena();
+    ~FrameArena();
+
+    /** Ensures capacity bytes and drops all allocations. */
+    bool Reserve(std::size_t capacity);
+    /** Returns zeroed memory, nullptr when the arena is exhausted. */
+    void *Allocate(std::size_t size, std::size_t align = 64);
+    /** Drops all allocations, keeping the block. */
+    void Reset();
+
+    std::size_t capacity() const { return capacity_; }
+    std::size_t used() const { return used_; }
+
+private:
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    unsigned char *data_;
+    std::size_t capacity_;
+    std::size_t used_;
+};
+
+/** Peak resident set size of the process in bytes, 0 if unknown. */
+MYNTEYE_API std::size_t GetPeakResidentSize();
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_MEMORY_PROFILE_H_
@@ -0,0 +1,247 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "occupancy_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include "simd.h"
+
+using namespace mynteye;
+
+namespace {
+
+const std::int32_t kMaxStripes = 16;
+// Released grids kept for reuse, the front one and the one Update fills.
+const std::size_t kPoolFrames = 2;
+const std::int16_t kEmptyTop = std::numeric_limits<std::int16_t>::min();
+// Heights in millimeters must fit OccupancyGridFrame::top above kEmptyTop.
+const float kMaxHeight = 32.767f;
+
+void Check(bool ok, const char *what) {
+    if (!ok) throw std::invalid_argument(std::string("OccupancyGrid: ") + what);
+}
+
+/** Cells along an extent, 0 if it is empty or not finite. */
+double CellCount(float min, float max, float cell) {
+    float n = std::ceil((max - min) / cell);
+    return std::isfinite(n) && n >= 1 ? n : 0;
+}
+
+/** First depth in [lo, 0x10000) for which f holds, f must not go back to false. */
+template <typename F>
+std::uint32_t FirstDepth(std::uint32_t lo, F f) {
+    std::uint32_t hi = 0x10000;
+    while (lo < hi) {
+        std::uint32_t mid = lo + (hi - lo) / 2;
+        if (f(mid)) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+}  // namespace
+
+class OccupancyGrid::ProjectBody : public cv::ParallelLoopBody {
+public:
+    ProjectBody(OccupancyGrid *grid, const std::uint16_t *depth) : grid_(grid), depth_(depth) {}
+
+    void operator()(const cv::Range &range) const override {
+        for (int stripe = range.start; stripe < range.end; stripe++) {
+            grid_->ProjectStripe(depth_, stripe);
+        }
+    }
+
+private:
+    OccupancyGrid *grid_;
+    const std::uint16_t *depth_;
+};
+
+OccupancyGrid::OccupancyGrid(std::int32_t width, std::int32_t height,
+        const OccupancyGridParams &params)
+    : width_(width), height_(height), params_(params), frame_id_(0) {
+    Check(width_ > 0 && height_ > 0, "image size must be positive");
+    Check(params_.fx > 0 && params_.fy > 0 && std::isfinite(params_.fx) && std::isfinite(params_.fy),
+        "fx and fy must be positive");
+    Check(std::isfinite(params_.cx) && std::isfinite(params_.cy), "cx and cy must be finite");
+    Check(params_.depth_scale > 0 && std::isfinite(params_.depth_scale), "depth_scale must be positive");
+    Check(params_.cell_size > 0 && std::isfinite(params_.cell_size), "cell_size must be positive");
+    params_.height_min = std::max(params_.height_min, -kMaxHeight);
+    params_.height_max = std::min(params_.height_max, kMaxHeight);
+    Check(params_.height_min <= params_.height_max, "height band is empty");
+
+    const float cell = params_.cell_size;
+    double cols = CellCount(params_.x_min, params_.x_max, cell);
+    double rows = CellCount(params_.z_min, params_.z_max, cell);
+    Check(cols > 0 && rows > 0, "x or z extent is empty");
+    Check(cols * rows <= kMaxCells, "grid has more than kMaxCells cells");
+    cols_ = std::int32_t(cols);
+    rows_ = std::int32_t(rows);
+
+    // col = (x - x_min) / cell with x = d * depth_scale * (u - cx) / fx.
+    ray_col_.resize(width_);
+    for (std::int32_t u = 0; u < width_; u++) {
+        ray_col_[u] = params_.depth_scale * (u - params_.cx) / (params_.fx * cell);
+    }
+    col_offset_ = -params_.x_min / cell;
+    // Image y points down, heights are taken upwards and in millimeters.
+    ray_height_.resize(height_);
+    for (std::int32_t v = 0; v < height_; v++) {
+        ray_height_[v] = -1000.f * params_.depth_scale * (v - params_.cy) / params_.fy;
+    }
+    row_scale_ = params_.depth_scale / cell;
+    row_offset_ = -params_.z_min / cell;
+    // A prefilter only: ProjectStripe tests the cell row it uses. Widened by
+    // a depth unit each way, as rounding here may differ from the loop's.
+    const float grid_rows = float(rows_);
+    std::uint32_t lo = FirstDepth(1, [this](std::uint32_t d) {
+        return float(d) * row_scale_ + row_offset_ >= 0.f;
+    });
+    std::uint32_t end = FirstDepth(lo, [this, grid_rows](std::uint32_t d) {
+        return float(d) * row_scale_ + row_offset_ >= grid_rows;
+    });
+    depth_lo_ = std::uint16_t(std::min<std::uint32_t>(std::max<std::uint32_t>(lo, 2) - 1, 0xFFFF));
+    depth_hi_ = std::uint16_t(std::min<std::uint32_t>(end, 0xFFFF));
+
+    stripes_ = std::min(std::max(cv::getNumThreads(), 1), kMaxStripes);
+    stripes_ = std::min(stripes_, std::max(height_, 1));
+    std::size_t cells = std::size_t(cols_) * rows_;
+    stripe_hits_.resize(cells * stripes_);
+    stripe_top_.resize(cells * stripes_);
+    stripe_cells_.resize(std::size_t(width_) * stripes_);
+    stripe_depth_.resize(std::size_t(width_) * stripes_);
+
+    pool_ = std::make_shared<FramePool>();
+    // Reserved, so returning a grid never allocates in a reader's release.
+    pool_->frames.reserve(kPoolFrames);
+    pool_->frames.push_back(TakeFrame());
+    front_ = Share(TakeFrame());
+}
+
+OccupancyGrid::~OccupancyGrid() {
+}
+
+void OccupancyGrid::Update(const std::uint16_t *depth) {
+    cv::parallel_for_(cv::Range(0, stripes_), ProjectBody(this, depth), stripes_);
+
+    std::unique_ptr<OccupancyGridFrame> back = TakeFrame();
+    Merge(*back);
+    back->frame_id = ++frame_id_;
+
+    std::shared_ptr<OccupancyGridFrame> front = Share(std::move(back));
+    {
+        std::lock_guard<std::mutex> _(front_mtx_);
+        front_.swap(front);
+    }
+    // The old front returns to the pool here unless a reader still holds it.
+}
+
+std::shared_ptr<const OccupancyGridFrame> OccupancyGrid::GetFront() {
+    std::lock_guard<std::mutex> _(front_mtx_);
+    return front_;
+}
+
+std::unique_ptr<OccupancyGridFrame> OccupancyGrid::TakeFrame() {
+    {
+        std::lock_guard<std::mutex> _(pool_->mtx);
+        if (!pool_->frames.empty()) {
+            std::unique_ptr<OccupancyGridFrame> frame = std::move(pool_->frames.back());
+            pool_->frames.pop_back();
+            return frame;
+        }
+    }
+    const std::size_t cells = std::size_t(cols_) * rows_;
+    std::unique_ptr<OccupancyGridFrame> frame(new OccupancyGridFrame());
+    frame->cols = cols_;
+    frame->rows = rows_;
+    frame->hits.assign(cells, 0);
+    frame->top.assign(cells, kEmptyTop);
+    frame->occupied.assign(cells, 0);
+    return frame;
+}
+
+std::shared_ptr<OccupancyGridFrame> OccupancyGrid::Share(std::unique_ptr<OccupancyGridFrame> frame) {
+    // Holds the pool, snapshots may outlive the grid.
+    std::shared_ptr<FramePool> pool = pool_;
+    return std::shared_ptr<OccupancyGridFrame>(frame.release(), [pool](OccupancyGridFrame *released) {
+        std::lock_guard<std::mutex> _(pool->mtx);
+        if (pool->frames.size() < kPoolFrames) pool->frames.emplace_back(released);
+        else delete released;
+    });
+}
+
+void OccupancyGrid::ProjectStripe(const std::uint16_t *depth, std::int32_t stripe) {
+    const std::size_t cells = std::size_t(cols_) * rows_;
+    std::uint32_t *hits = stripe_hits_.data() + cells * stripe;
+    std::int16_t *top = stripe_top_.data() + cells * stripe;
+    std::int32_t *row_cells = stripe_cells_.data() + std::size_t(width_) * stripe;
+    std::uint16_t *row_depth = stripe_depth_.data() + std::size_t(width_) * stripe;
+    std::fill(hits, hits + cells, 0u);
+    std::fill(top, top + cells, kEmptyTop);
+
+    const float cols = float(cols_);
+    const float rows = float(rows_);
+    const float height_min = params_.height_min * 1000.f;
+    const float height_max = params_.height_max * 1000.f;
+    const float *ray_col = ray_col_.data();
+
+    std::int32_t v_begin = std::int32_t(std::int64_t(height_) * stripe / stripes_);
+    std::int32_t v_end = std::int32_t(std::int64_t(height_) * (stripe + 1) / stripes_);
+    for (std::int32_t v = v_begin; v < v_end; v++) {
+        const std::uint16_t *row = row_depth;
+        const float ray_height = ray_height_[v];
+        // Zeroes invalid depths and those far outside the z extent.
+        DepthRangeFilter(depth + std::size_t(v) * width_, row_depth, width_, depth_lo_, depth_hi_);
+
+        // Branch-free cell lookup, left to the compiler to vectorize.
+        for (std::int32_t u = 0; u < width_; u++) {
+            float d = float(row[u]);
+            float col = d * ray_col[u] + col_offset_;
+            float cell_row = d * row_scale_ + row_offset_;
+            float h = d * ray_height;
+            bool inside = row[u] != 0 &&
+                col >= 0.f && col < cols &&
+                cell_row >= 0.f && cell_row < rows &&
+                h >= height_min && h <= height_max;
+            row_cells[u] = inside ? std::int32_t(cell_row) * cols_ + std::int32_t(col) : -1;
+        }
+
+        for (std::int32_t u = 0; u < width_; u++) {
+            std::int32_t c = row_cells[u];
+            if (c < 0) continue;
+            hits[c]++;
+            std::int16_t h = std::int16_t(float(row[u]) * ray_height);
+            if (h > top[c]) top[c] = h;
+        }
+    }
+}
+
+void OccupancyGrid::Merge(OccupancyGridFrame &frame) {
+    const std::size_t cells = std::size_t(cols_) * rows_;
+    for (std::size_t c = 0; c < cells; c++) {
+        std::uint32_t hits = 0;
+        std::int16_t top = kEmptyTop;
+        for (std::int32_t s = 0; s < stripes_; s++) {
+            hits += stripe_hits_[cells * s + c];
+            top = std::max(top, stripe_top_[cells * s + c]);
+        }
+        frame.hits[c] = std::uint16_t(std::min<std::uint32_t>(hits, 0xFFFF));
+        frame.top[c] = top;
+        frame.occupied[c] = hits >= params_.min_hits ? 255 : 0;
+    }
+}
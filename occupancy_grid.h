@@ -0,0 +1,152 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_OCCUPANCY_GRID_H_
+#define MYNTEYE_API_OCCUPANCY_GRID_H_
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+struct MYNTEYE_API OccupancyGridParams {
+    /** Depth intrinsics in pixels. */
+    float fx = 0;
+    float fy = 0;
+    float cx = 0;
+    float cy = 0;
+    /** Meters per depth unit, depth is in millimeters. */
+    float depth_scale = 0.001f;
+
+    /** Cell edge in meters. */
+    float cell_size = 0.05f;
+    /** Lateral (x, right) and forward (z) extent in meters. */
+    float x_min = -2.f;
+    float x_max = 2.f;
+    float z_min = 0.2f;
+    float z_max = 4.f;
+    /**
+     * Height band in meters above the optical center, camera assumed level.
+     * Clamped to +-32.767 m, the range of OccupancyGridFrame::top.
+     */
+    float height_min = -0.3f;
+    float height_max = 0.5f;
+    /** Points needed for a cell to count as occupied. */
+    std::uint16_t min_hits = 3;
+};
+
+/** Top-down grid, row-major with rows along z and columns along x. */
+struct MYNTEYE_API OccupancyGridFrame {
+    std::int32_t cols = 0;
+    std::int32_t rows = 0;
+    std::uint64_t frame_id = 0;
+    /** Points that fell into each cell. */
+    std::vector<std::uint16_t> hits;
+    /** Highest point of each cell in millimeters, numeric_limits<int16_t>::min() when empty. */
+    std::vector<std::int16_t> top;
+    /** 255 where hits >= min_hits, else 0. */
+    std::vector<std::uint8_t> occupied;
+};
+
+/**
+ * Projects depth frames into a 2.5D occupancy grid.
+ *
+ * Rays are precomputed from the intrinsics, already divided by the cell
+ * size, so a pixel maps to its cell with one multiply-add per axis. Depths
+ * that cannot reach the grid are dropped per row with DepthRangeFilter.
+ * Row stripes are projected in parallel into per-stripe grids that are
+ * then summed. The result is double buffered: GetFront returns the last
+ * complete grid while Update builds the next one.
+ */
+class MYNTEYE_API OccupancyGrid {
+public:
+    static const std::int32_t kMaxCells = 1 << 22;
+
+    /**
+     * Throws std::invalid_argument unless the image size, fx, fy,
+     * depth_scale and cell_size are positive, every extent is non-empty
+     * and the grid has at most kMaxCells cells.
+     */
+    OccupancyGrid(std::int32_t width, std::int32_t height, const OccupancyGridParams &params);
+    ~OccupancyGrid();
+
+    void Update(const std::uint16_t *depth);
+
+    /**
+     * The last complete grid, never changed afterwards. Its buffers go back
+     * to Update once the last snapshot is released, so two grids take turns
+     * unless readers hold on to older ones.
+     */
+    std::shared_ptr<const OccupancyGridFrame> GetFront();
+
+private:
+    OccupancyGrid(const OccupancyGrid &) = delete;
+    OccupancyGrid &operator=(const OccupancyGrid &) = delete;
+
+    class ProjectBody;
+
+    /** Released grids, shared with the snapshots that return to it. */
+    struct FramePool {
+        std::mutex mtx;
+        std::vector<std::unique_ptr<OccupancyGridFrame>> frames;
+    };
+
+    /** Projects the depth rows of one stripe into its partial grid. */
+    void ProjectStripe(const std::uint16_t *depth, std::int32_t stripe);
+
+    void Merge(OccupancyGridFrame &frame);
+    /** A released grid, or a new one. */
+    std::unique_ptr<OccupancyGridFrame> TakeFrame();
+    /** Shares frame, returning it to the pool once released. */
+    std::shared_ptr<OccupancyGridFrame> Share(std::unique_ptr<OccupancyGridFrame> frame);
+
+    std::int32_t width_;
+    std::int32_t height_;
+    OccupancyGridParams params_;
+    std::int32_t cols_;
+    std::int32_t rows_;
+
+    /** Cell column per depth unit of each image column, and the offset. */
+    std::vector<float> ray_col_;
+    float col_offset_;
+    /** Height in millimeters per depth unit of each image row. */
+    std::vector<float> ray_height_;
+    /** Cell row per depth unit, and the offset. */
+    float row_scale_;
+    float row_offset_;
+    /** Depths whose cell row may lie inside the grid, a superset. */
+    std::uint16_t depth_lo_;
+    std::uint16_t depth_hi_;
+
+    std::int32_t stripes_;
+    std::vector<std::uint32_t> stripe_hits_;
+    std::vector<std::int16_t> stripe_top_;
+    std::vector<std::int32_t> stripe_cells_;
+    std::vector<std::uint16_t> stripe_depth_;
+
+    std::shared_ptr<FramePool> pool_;
+    /** Guarded by front_mtx_. */
+    std::shared_ptr<OccupancyGridFrame> front_;
+    std::uint64_t frame_id_;
+    std::mutex front_mtx_;
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_OCCUPANCY_GRID_H_
@@ -0,0 +1,257 @@
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "occupancy_grid.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: occupancy_grid_test
+//
+// Checks OccupancyGrid against a naive per-pixel projection in double
+// precision over random frames and parameters, then the double buffer:
+// snapshots keep their grid while Update goes on, also with a reader
+// thread, and invalid parameters are refused.
+
+namespace {
+
+const int kWidth = 160;
+const int kHeight = 120;
+
+mt19937 rng(3);
+
+int failures = 0;
+
+void Check(bool ok, const string &what) {
+    cout << (ok ? "ok     " : "FAILED ") << what << endl;
+    if (!ok) failures++;
+}
+
+OccupancyGridParams TestParams() {
+    OccupancyGridParams params;
+    params.fx = params.fy = 120.f;
+    params.cx = kWidth / 2.f;
+    params.cy = kHeight / 2.f;
+    return params;
+}
+
+/** Where the naive projection puts a depth pixel, cell -1 if nowhere. */
+struct Point {
+    int cell;
+    double height;
+    /** Within rounding of a cell edge or the height band. */
+    bool ambiguous;
+};
+
+Point Project(const OccupancyGridParams &p, int cols, int rows, int u, int v, uint16_t d) {
+    const double eps = 1e-3;
+    double z = d * double(p.depth_scale);
+    double x = z * (u - double(p.cx)) / p.fx;
+    double y = -z * (v - double(p.cy)) / p.fy;
+    double col = (x - p.x_min) / p.cell_size;
+    double row = (z - p.z_min) / p.cell_size;
+    double h = y * 1000.0;
+    double h_min = max(double(p.height_min), -32.767) * 1000.0;
+    double h_max = min(double(p.height_max), 32.767) * 1000.0;
+    Point point;
+    point.height = h;
+    point.ambiguous = fabs(col - round(col)) < eps || fabs(row - round(row)) < eps ||
+        fabs(h - h_min) < eps || fabs(h - h_max) < eps || fabs(h - round(h)) < eps;
+    bool inside = d != 0 && col >= 0 && col < cols && row >= 0 && row < rows &&
+        h >= h_min && h <= h_max;
+    point.cell = inside ? int(row) * cols + int(col) : -1;
+    return point;
+}
+
+/**
+ * Random depths, near the grid mostly; pixels the two projections could
+ * round differently are made invalid so the comparison can be exact.
+ */
+vector<uint16_t> MakeFrame(const OccupancyGridParams &p, int cols, int rows) {
+    vector<uint16_t> depth(kWidth * kHeight);
+    uniform_int_distribution<int> near_depth(1, int(p.z_max / p.depth_scale) + 500);
+    for (int v = 0; v < kHeight; v++) {
+        for (int u = 0; u < kWidth; u++) {
+            uint16_t d;
+            switch (rng() % 8) {
+            case 0: d = 0; break;
+            case 1: d = uint16_t(rng()); break;
+            default: d = uint16_t(near_depth(rng)); break;
+            }
+            if (Project(p, cols, rows, u, v, d).ambiguous) d = 0;
+            depth[v * kWidth + u] = d;
+        }
+    }
+    return depth;
+}
+
+bool MatchesNaive(const OccupancyGridParams &p, const vector<uint16_t> &depth,
+        const OccupancyGridFrame &frame) {
+    size_t cells = size_t(frame.cols) * frame.rows;
+    vector<uint32_t> hits(cells, 0);
+    vector<int16_t> top(cells, numeric_limits<int16_t>::min());
+    for (int v = 0; v < kHeight; v++) {
+        for (int u = 0; u < kWidth; u++) {
+            Point point = Project(p, frame.cols, frame.rows, u, v, depth[v * kWidth + u]);
+            if (point.cell < 0) continue;
+            hits[point.cell]++;
+            top[point.cell] = max(top[point.cell], int16_t(point.height));
+        }
+    }
+    for (size_t c = 0; c < cells; c++) {
+        uint8_t occupied = hits[c] >= p.min_hits ? 255 : 0;
+        if (frame.hits[c] != hits[c] || frame.top[c] != top[c] || frame.occupied[c] != occupied) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TestNaive() {
+    const int kRounds = 30;
+    int matched = 0;
+    for (int round = 0; round < kRounds; round++) {
+        OccupancyGridParams p = TestParams();
+        p.fx = 80.f + round * 7;
+        p.fy = p.fx * (round % 2 ? 1.f : 1.1f);
+        p.cx += round % 5;
+        p.cell_size = 0.02f + 0.011f * (round % 9);
+        p.x_min = -0.5f - 0.1f * (round % 4);
+        p.x_max = 0.4f + 0.2f * (round % 3);
+        p.z_min = 0.05f * (round % 6);
+        p.z_max = p.z_min + 0.5f + 0.25f * (round % 7);
+        p.height_min = -0.2f - 0.1f * (round % 3);
+        p.height_max = round == 7 ? 100.f : 0.3f;
+        p.min_hits = uint16_t(1 + round % 4);
+
+        OccupancyGrid grid(kWidth, kHeight, p);
+        shared_ptr<const OccupancyGridFrame> front = grid.GetFront();
+        vector<uint16_t> depth = MakeFrame(p, front->cols, front->rows);
+        grid.Update(depth.data());
+        if (MatchesNaive(p, depth, *grid.GetFront())) matched++;
+    }
+    Check(matched == kRounds, "cells match a naive projection, " + to_string(matched) +
+        " of " + to_string(kRounds) + " frames");
+}
+
+/** A frame that puts n points into the grid, the rest invalid. */
+vector<uint16_t> FrameWithHits(const OccupancyGridParams &p, int n) {
+    // Around the optical center, 1 m ahead.
+    vector<uint16_t> depth(kWidth * kHeight, 0);
+    for (int i = 0; i < n; i++) {
+        depth[(int(p.cy) - 2 + i / 4) * kWidth + int(p.cx) - 2 + i % 4] = 1000;
+    }
+    return depth;
+}
+
+uint32_t TotalHits(const OccupancyGridFrame &frame) {
+    uint32_t total = 0;
+    for (uint16_t h : frame.hits) total += h;
+    return total;
+}
+
+void TestDoubleBuffer() {
+    OccupancyGridParams p = TestParams();
+    OccupancyGrid grid(kWidth, kHeight, p);
+    vector<uint16_t> one = FrameWithHits(p, 1);
+    vector<uint16_t> two = FrameWithHits(p, 2);
+    vector<uint16_t> three = FrameWithHits(p, 3);
+
+    grid.Update(one.data());
+    shared_ptr<const OccupancyGridFrame> first = grid.GetFront();
+    grid.Update(two.data());
+    shared_ptr<const OccupancyGridFrame> second = grid.GetFront();
+    grid.Update(three.data());
+    grid.Update(one.data());
+    Check(first->frame_id == 1 && TotalHits(*first) == 1 &&
+        second->frame_id == 2 && TotalHits(*second) == 2,
+        "snapshots keep their grid while Update goes on");
+    shared_ptr<const OccupancyGridFrame> fourth = grid.GetFront();
+    Check(fourth->frame_id == 4 && TotalHits(*fourth) == 1, "the front is the last complete grid");
+
+    // Once released, Update goes back to reusing the two buffers.
+    first.reset();
+    second.reset();
+    const OccupancyGridFrame *a = fourth.get();
+    fourth.reset();
+    grid.Update(two.data());
+    const OccupancyGridFrame *b = grid.GetFront().get();
+    grid.Update(three.data());
+    grid.Update(two.data());
+    Check(grid.GetFront().get() == b && b != a, "released buffers are reused");
+
+    // From here odd frames put one point in, even ones two; a torn grid
+    // has neither.
+    const uint64_t start = grid.GetFront()->frame_id;
+    atomic<bool> done(false);
+    atomic<int> bad(0);
+    thread reader([&]() {
+        while (!done) {
+            shared_ptr<const OccupancyGridFrame> front = grid.GetFront();
+            if (front->frame_id <= start) continue;
+            uint32_t want = front->frame_id % 2 ? 1 : 2;
+            if (TotalHits(*front) != want) bad++;
+        }
+    });
+    for (int i = 0; i < 2000; i++) {
+        grid.Update((grid.GetFront()->frame_id + 1) % 2 ? one.data() : two.data());
+    }
+    done = true;
+    reader.join();
+    Check(bad == 0, "a reader thread never sees a torn grid");
+}
+
+bool Refused(OccupancyGridParams p, int width = kWidth, int height = kHeight) {
+    try {
+        OccupancyGrid grid(width, height, p);
+    }
+    catch (const invalid_argument &) {
+        return true;
+    }
+    return false;
+}
+
+void TestInvalidParams() {
+    OccupancyGridParams p = TestParams();
+    bool ok = !Refused(p);
+    p.cell_size = 0;
+    ok = ok && Refused(p);
+    p = TestParams();
+    p.fx = 0;
+    ok = ok && Refused(p);
+    p = TestParams();
+    p.fy = numeric_limits<float>::quiet_NaN();
+    ok = ok && Refused(p);
+    p = TestParams();
+    p.x_max = p.x_min;
+    ok = ok && Refused(p);
+    p = TestParams();
+    p.z_max = p.z_min - 1;
+    ok = ok && Refused(p);
+    p = TestParams();
+    p.height_max = p.height_min - 0.1f;
+    ok = ok && Refused(p);
+    p = TestParams();
+    p.cell_size = 1e-5f;
+    ok = ok && Refused(p);
+    ok = ok && Refused(TestParams(), 0, kHeight);
+    Check(ok, "invalid parameters are refused");
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+    TestNaive();
+    TestDoubleBuffer();
+    TestInvalidParams();
+    return failures ? 1 : 0;
+}
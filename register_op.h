@@ -0,0 +1,47 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_REGISTER_OP_H_
+#define MYNTEYE_API_REGISTER_OP_H_
+#pragma once
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+enum class RegisterType {
+    SENSOR,
+    HW,
+    FW
+};
+
+/**
+ * One register access of a batch. Reads fill value, writes take it; ok is
+ * set once the batch ran.
+ */
+struct MYNTEYE_API RegisterOp {
+    RegisterType type;
+    /** Sensor id, used by SENSOR registers only. */
+    int sensor_id;
+    unsigned short address;
+    unsigned short value;
+    bool ok;
+
+    RegisterOp(RegisterType type, unsigned short address, unsigned short value = 0,
+        int sensor_id = 0)
+        : type(type), sensor_id(sensor_id), address(address), value(value), ok(false) {}
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_REGISTER_OP_H_
@@ -0,0 +1,188 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "simd_p.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_M_IX86)
+#include <intrin.h>
+#endif
+#if defined(__arm__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#include "log.hpp"
+
+using namespace mynteye;
+
+namespace {
+
+void DecodeDepth16Scalar(const std::uint8_t *src, std::uint16_t *dst, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        dst[i] = std::uint16_t(src[2 * i] | (src[2 * i + 1] << 8));
+    }
+}
+
+void ZigZagDelta16Scalar(const std::uint16_t *src, std::uint16_t pred,
+        std::uint32_t *dst, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        std::int32_t r = std::int32_t(src[i]) - std::int32_t(pred);
+        dst[i] = (std::uint32_t(r) << 1) ^ std::uint32_t(r >> 31);
+        pred = src[i];
+    }
+}
+
+void QuantizeDelta16Scalar(const std::uint16_t *src, const std::uint16_t *pred,
+        std::uint16_t max_error, std::uint16_t *recon, std::uint32_t *res, std::size_t n) {
+    const std::int32_t e = max_error;
+    const std::int32_t step = 2 * e + 1;
+    for (std::size_t i = 0; i < n; i++) {
+        std::int32_t r = std::int32_t(src[i]) - std::int32_t(pred[i]);
+        std::int32_t q = (r < 0 ? -r : r) + e;
+        q /= step;
+        if (r < 0) q = -q;
+        std::int32_t v = std::int32_t(pred[i]) + q * step;
+        recon[i] = std::uint16_t(v < 0 ? 0 : (v > 0xFFFF ? 0xFFFF : v));
+        res[i] = (std::uint32_t(q) << 1) ^ std::uint32_t(q >> 31);
+    }
+}
+
+void DepthRangeFilterScalar(const std::uint16_t *src, std::uint16_t *dst, std::size_t n,
+        std::uint16_t lo, std::uint16_t hi) {
+    for (std::size_t i = 0; i < n; i++) {
+        dst[i] = (src[i] >= lo && src[i] <= hi) ? src[i] : 0;
+    }
+}
+
+const SimdKernels kScalarKernels = {
+    DecodeDepth16Scalar,
+    ZigZagDelta16Scalar,
+    QuantizeDelta16Scalar,
+    DepthRangeFilterScalar,
+};
+
+bool CpuHasSse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(__i386__) && defined(__GNUC__)
+    return __builtin_cpu_supports("sse2");
+#elif defined(_M_IX86)
+    int info[4];
+    __cpuid(info, 1);
+    return ((info[3] >> 26) & 1) != 0;
+#else
+    return false;
+#endif
+}
+
+bool CpuHasNeon() {
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return true;
+#elif defined(__arm__) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return false;
+#endif
+}
+
+const SimdKernels *KernelsFor(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2:
+        return CpuHasSse2() ? GetSse2Kernels() : nullptr;
+    case SimdLevel::NEON:
+        return CpuHasNeon() ? GetNeonKernels() : nullptr;
+    case SimdLevel::SCALAR:
+    default:
+        return &kScalarKernels;
+    }
+}
+
+struct Dispatch {
+    std::atomic<SimdLevel> level;
+    std::atomic<const SimdKernels *> kernels;
+
+    Dispatch() : level(SimdLevel::SCALAR), kernels(&kScalarKernels) {
+        const char *env = getenv("MYNTEYE_SIMD");
+        if (env && strcmp(env, "scalar") == 0) return;
+        // NEON stays opt-in through SetSimdLevel until simd_test has passed
+        // on ARM; it was only checked against an x86 emulation of the
+        // intrinsics.
+        const SimdLevel levels[] = { SimdLevel::SSE2 };
+        for (SimdLevel l : levels) {
+            const SimdKernels *k = KernelsFor(l);
+            if (k) {
+                level = l;
+                kernels = k;
+                break;
+            }
+        }
+        DBG_LOGI("SIMD kernels: %s", GetSimdLevelName(level));
+    }
+};
+
+Dispatch &GetDispatch() {
+    static Dispatch dispatch;
+    return dispatch;
+}
+
+}  // namespace
+
+const SimdKernels *mynteye::GetScalarKernels() {
+    return &kScalarKernels;
+}
+
+SimdLevel mynteye::GetSimdLevel() {
+    return GetDispatch().level;
+}
+
+bool mynteye::SetSimdLevel(SimdLevel level) {
+    const SimdKernels *kernels = KernelsFor(level);
+    if (!kernels) return false;
+    Dispatch &dispatch = GetDispatch();
+    dispatch.level = level;
+    dispatch.kernels = kernels;
+    return true;
+}
+
+const char *mynteye::GetSimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2: return "SSE2";
+    case SimdLevel::NEON: return "NEON";
+    case SimdLevel::SCALAR:
+    default: return "scalar";
+    }
+}
+
+void mynteye::DecodeDepth16(const std::uint8_t *src, std::uint16_t *dst, std::size_t n) {
+    GetDispatch().kernels.load(std::memory_order_relaxed)->decode_depth16(src, dst, n);
+}
+
+void mynteye::ZigZagDelta16(const std::uint16_t *src, std::uint16_t pred,
+        std::uint32_t *dst, std::size_t n) {
+    GetDispatch().kernels.load(std::memory_order_relaxed)->zigzag_delta16(src, pred, dst, n);
+}
+
+void mynteye::QuantizeDelta16(const std::uint16_t *src, const std::uint16_t *pred,
+        std::uint16_t max_error, std::uint16_t *recon, std::uint32_t *res, std::size_t n) {
+    GetDispatch().kernels.load(std::memory_order_relaxed)->quantize_delta16(
+        src, pred, max_error, recon, res, n);
+}
+
+void mynteye::DepthRangeFilter(const std::uint16_t *src, std::uint16_t *dst, std::size_t n,
+        std::uint16_t lo, std::uint16_t hi) {
+    GetDispatch().kernels.load(std::memory_order_relaxed)->depth_range_filter(src, dst, n, lo, hi);
+}
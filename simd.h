@@ -0,0 +1,68 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_SIMD_H_
+#define MYNTEYE_API_SIMD_H_
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+enum class SimdLevel {
+    SCALAR,
+    SSE2,
+    NEON
+};
+
+/**
+ * The kernel set in use, picked at first use from what the CPU supports.
+ * Setting MYNTEYE_SIMD=scalar in the environment forces the scalar set.
+ * NEON is never picked: it has not been run on ARM yet, see simd_test.
+ */
+MYNTEYE_API SimdLevel GetSimdLevel();
+/**
+ * Switches kernel sets, false if level is not available on this CPU.
+ * The only way to use the unverified NEON set.
+ */
+MYNTEYE_API bool SetSimdLevel(SimdLevel level);
+MYNTEYE_API const char *GetSimdLevelName(SimdLevel level);
+
+/** Assembles little-endian depth bytes (2 per pixel) into n samples. */
+MYNTEYE_API void DecodeDepth16(const std::uint8_t *src, std::uint16_t *dst, std::size_t n);
+
+/**
+ * Zig-zag mapped left-neighbour residuals of n samples, the first one
+ * predicted from pred.
+ */
+MYNTEYE_API void ZigZagDelta16(const std::uint16_t *src, std::uint16_t pred,
+    std::uint32_t *dst, std::size_t n);
+
+/**
+ * Quantizes the residuals of n samples against pred to steps of
+ * 2 * max_error + 1, rounding to nearest. Writes the zig-zag mapped steps
+ * to res and the reconstructed samples, clamped to 16 bits, to recon.
+ */
+MYNTEYE_API void QuantizeDelta16(const std::uint16_t *src, const std::uint16_t *pred,
+    std::uint16_t max_error, std::uint16_t *recon, std::uint32_t *res, std::size_t n);
+
+/** Copies n samples, zeroing those outside [lo, hi]. */
+MYNTEYE_API void DepthRangeFilter(const std::uint16_t *src, std::uint16_t *dst, std::size_t n,
+    std::uint16_t lo, std::uint16_t hi);
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_SIMD_H_
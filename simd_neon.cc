@@ -0,0 +1,134 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "simd_p.h"
+
+// Unverified: never run on ARM hardware or under qemu, so dispatch does not
+// pick these. Run simd_test on ARM before enabling them.
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define MYNTEYE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace mynteye;
+
+#ifdef MYNTEYE_SIMD_NEON
+
+namespace {
+
+// De-interleaves low and high bytes, so it does not depend on byte order.
+void DecodeDepth16Neon(const std::uint8_t *src, std::uint16_t *dst, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x2_t bytes = vld2q_u8(src + 2 * i);
+        uint16x8_t lo = vorrq_u16(vmovl_u8(vget_low_u8(bytes.val[0])),
+            vshlq_n_u16(vmovl_u8(vget_low_u8(bytes.val[1])), 8));
+        uint16x8_t hi = vorrq_u16(vmovl_u8(vget_high_u8(bytes.val[0])),
+            vshlq_n_u16(vmovl_u8(vget_high_u8(bytes.val[1])), 8));
+        vst1q_u16(dst + i, lo);
+        vst1q_u16(dst + i + 8, hi);
+    }
+    GetScalarKernels()->decode_depth16(src + 2 * i, dst + i, n - i);
+}
+
+inline uint32x4_t ZigZag32(uint32x4_t diff) {
+    int32x4_t r = vreinterpretq_s32_u32(diff);
+    return veorq_u32(vreinterpretq_u32_s32(vshlq_n_s32(r, 1)),
+        vreinterpretq_u32_s32(vshrq_n_s32(r, 31)));
+}
+
+void ZigZagDelta16Neon(const std::uint16_t *src, std::uint16_t pred,
+        std::uint32_t *dst, std::size_t n) {
+    if (n == 0) return;
+    GetScalarKernels()->zigzag_delta16(src, pred, dst, 1);
+    std::size_t i = 1;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t cur = vld1q_u16(src + i);
+        uint16x8_t prev = vld1q_u16(src + i - 1);
+        // Widening subtraction wraps to the two's complement difference.
+        vst1q_u32(dst + i, ZigZag32(vsubl_u16(vget_low_u16(cur), vget_low_u16(prev))));
+        vst1q_u32(dst + i + 4, ZigZag32(vsubl_u16(vget_high_u16(cur), vget_high_u16(prev))));
+    }
+    if (i < n) {
+        GetScalarKernels()->zigzag_delta16(src + i, src[i - 1], dst + i, n - i);
+    }
+}
+
+// Four lanes of QuantizeDelta16, exact for the same reason as on SSE2:
+// (a + 0.5) / step stays further from an integer than float rounding goes.
+inline void QuantizeDelta32(uint32x4_t s, uint32x4_t p, float32x4_t bias, float32x4_t stepf,
+        float32x4_t inv, int32x4_t &q, int32x4_t &v) {
+    int32x4_t r = vsubq_s32(vreinterpretq_s32_u32(s), vreinterpretq_s32_u32(p));
+    float32x4_t af = vaddq_f32(vcvtq_f32_s32(vabsq_s32(r)), bias);
+    float32x4_t qf = vcvtq_f32_s32(vcvtq_s32_f32(vmulq_f32(af, inv)));
+    int32x4_t qa = vcvtq_s32_f32(qf);
+    int32x4_t qs = vcvtq_s32_f32(vmulq_f32(qf, stepf));
+    uint32x4_t neg = vcltq_s32(r, vdupq_n_s32(0));
+    q = vbslq_s32(neg, vnegq_s32(qa), qa);
+    v = vaddq_s32(vreinterpretq_s32_u32(p), vbslq_s32(neg, vnegq_s32(qs), qs));
+}
+
+void QuantizeDelta16Neon(const std::uint16_t *src, const std::uint16_t *pred,
+        std::uint16_t max_error, std::uint16_t *recon, std::uint32_t *res, std::size_t n) {
+    const float32x4_t bias = vdupq_n_f32(float(max_error) + 0.5f);
+    const float32x4_t stepf = vdupq_n_f32(float(2 * std::int32_t(max_error) + 1));
+    const float32x4_t inv = vdupq_n_f32(1.f / float(2 * std::int32_t(max_error) + 1));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t s = vld1q_u16(src + i);
+        uint16x8_t p = vld1q_u16(pred + i);
+        int32x4_t qlo, qhi, vlo, vhi;
+        QuantizeDelta32(vmovl_u16(vget_low_u16(s)), vmovl_u16(vget_low_u16(p)), bias, stepf, inv, qlo, vlo);
+        QuantizeDelta32(vmovl_u16(vget_high_u16(s)), vmovl_u16(vget_high_u16(p)), bias, stepf, inv, qhi, vhi);
+        // Saturating narrow clamps to [0, 0xFFFF].
+        vst1q_u16(recon + i, vcombine_u16(vqmovun_s32(vlo), vqmovun_s32(vhi)));
+        vst1q_u32(res + i, ZigZag32(vreinterpretq_u32_s32(qlo)));
+        vst1q_u32(res + i + 4, ZigZag32(vreinterpretq_u32_s32(qhi)));
+    }
+    GetScalarKernels()->quantize_delta16(src + i, pred + i, max_error, recon + i, res + i, n - i);
+}
+
+void DepthRangeFilterNeon(const std::uint16_t *src, std::uint16_t *dst, std::size_t n,
+        std::uint16_t lo, std::uint16_t hi) {
+    const uint16x8_t vlo = vdupq_n_u16(lo);
+    const uint16x8_t vhi = vdupq_n_u16(hi);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vld1q_u16(src + i);
+        uint16x8_t in = vandq_u16(vcgeq_u16(v, vlo), vcleq_u16(v, vhi));
+        vst1q_u16(dst + i, vandq_u16(v, in));
+    }
+    GetScalarKernels()->depth_range_filter(src + i, dst + i, n - i, lo, hi);
+}
+
+const SimdKernels kNeonKernels = {
+    DecodeDepth16Neon,
+    ZigZagDelta16Neon,
+    QuantizeDelta16Neon,
+    DepthRangeFilterNeon,
+};
+
+}  // namespace
+
+const SimdKernels *mynteye::GetNeonKernels() {
+    return &kNeonKernels;
+}
+
+#else
+
+const SimdKernels *mynteye::GetNeonKernels() {
+    return nullptr;
+}
+
+#endif  // MYNTEYE_SIMD_NEON
@@ -0,0 +1,41 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_CORE_SIMD_P_H_
+#define MYNTEYE_CORE_SIMD_P_H_
+#pragma once
+
+#include "simd.h"
+
+namespace mynteye {
+
+/** One implementation of every kernel in simd.h. */
+struct SimdKernels {
+    void (*decode_depth16)(const std::uint8_t *src, std::uint16_t *dst, std::size_t n);
+    void (*zigzag_delta16)(const std::uint16_t *src, std::uint16_t pred,
+        std::uint32_t *dst, std::size_t n);
+    void (*quantize_delta16)(const std::uint16_t *src, const std::uint16_t *pred,
+        std::uint16_t max_error, std::uint16_t *recon, std::uint32_t *res, std::size_t n);
+    void (*depth_range_filter)(const std::uint16_t *src, std::uint16_t *dst, std::size_t n,
+        std::uint16_t lo, std::uint16_t hi);
+};
+
+/** The reference every other kernel set must match bit for bit. */
+const SimdKernels *GetScalarKernels();
+/** nullptr when not compiled for this target. */
+const SimdKernels *GetSse2Kernels();
+const SimdKernels *GetNeonKernels();
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_CORE_SIMD_P_H_
@@ -0,0 +1,134 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "simd_p.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MYNTEYE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace mynteye;
+
+#ifdef MYNTEYE_SIMD_SSE2
+
+namespace {
+
+// x86 is little-endian, so assembling the bytes is a plain copy.
+void DecodeDepth16Sse2(const std::uint8_t *src, std::uint16_t *dst, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+    GetScalarKernels()->decode_depth16(src + 2 * i, dst + i, n - i);
+}
+
+inline __m128i ZigZag32(__m128i r) {
+    return _mm_xor_si128(_mm_slli_epi32(r, 1), _mm_srai_epi32(r, 31));
+}
+
+void ZigZagDelta16Sse2(const std::uint16_t *src, std::uint16_t pred,
+        std::uint32_t *dst, std::size_t n) {
+    if (n == 0) return;
+    GetScalarKernels()->zigzag_delta16(src, pred, dst, 1);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 1;
+    for (; i + 8 <= n; i += 8) {
+        __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i - 1));
+        __m128i lo = _mm_sub_epi32(_mm_unpacklo_epi16(cur, zero), _mm_unpacklo_epi16(prev, zero));
+        __m128i hi = _mm_sub_epi32(_mm_unpackhi_epi16(cur, zero), _mm_unpackhi_epi16(prev, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), ZigZag32(lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), ZigZag32(hi));
+    }
+    if (i < n) {
+        GetScalarKernels()->zigzag_delta16(src + i, src[i - 1], dst + i, n - i);
+    }
+}
+
+// Four lanes of QuantizeDelta16. For a = |r| + e < 2^18, (a + 0.5) / step
+// is at least 0.5 / step away from an integer, a margin float rounding
+// cannot cross, so truncating the float quotient is exact.
+inline void QuantizeDelta32(__m128i s, __m128i p, __m128 bias, __m128 stepf, __m128 inv,
+        __m128i &q, __m128i &v) {
+    __m128i r = _mm_sub_epi32(s, p);
+    __m128i sign = _mm_srai_epi32(r, 31);
+    __m128 af = _mm_add_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_xor_si128(r, sign), sign)), bias);
+    __m128 qf = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(af, inv)));
+    __m128i qa = _mm_cvttps_epi32(qf);
+    __m128i qs = _mm_cvttps_epi32(_mm_mul_ps(qf, stepf));
+    q = _mm_sub_epi32(_mm_xor_si128(qa, sign), sign);
+    v = _mm_add_epi32(p, _mm_sub_epi32(_mm_xor_si128(qs, sign), sign));
+}
+
+void QuantizeDelta16Sse2(const std::uint16_t *src, const std::uint16_t *pred,
+        std::uint16_t max_error, std::uint16_t *recon, std::uint32_t *res, std::size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 bias = _mm_set1_ps(float(max_error) + 0.5f);
+    const __m128 stepf = _mm_set1_ps(float(2 * std::int32_t(max_error) + 1));
+    const __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), stepf);
+    const __m128i offset = _mm_set1_epi32(0x8000);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pred + i));
+        __m128i qlo, qhi, vlo, vhi;
+        QuantizeDelta32(_mm_unpacklo_epi16(s, zero), _mm_unpacklo_epi16(p, zero), bias, stepf, inv, qlo, vlo);
+        QuantizeDelta32(_mm_unpackhi_epi16(s, zero), _mm_unpackhi_epi16(p, zero), bias, stepf, inv, qhi, vhi);
+        // Signed saturation around 0x8000 clamps to [0, 0xFFFF].
+        __m128i v = _mm_packs_epi32(_mm_sub_epi32(vlo, offset), _mm_sub_epi32(vhi, offset));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(recon + i),
+            _mm_xor_si128(v, _mm_set1_epi16(short(0x8000))));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(res + i), ZigZag32(qlo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(res + i + 4), ZigZag32(qhi));
+    }
+    GetScalarKernels()->quantize_delta16(src + i, pred + i, max_error, recon + i, res + i, n - i);
+}
+
+void DepthRangeFilterSse2(const std::uint16_t *src, std::uint16_t *dst, std::size_t n,
+        std::uint16_t lo, std::uint16_t hi) {
+    // SSE2 only compares signed words, so shift everything by 0x8000.
+    const __m128i bias = _mm_set1_epi16(short(0x8000));
+    const __m128i vlo = _mm_set1_epi16(short(lo ^ 0x8000));
+    const __m128i vhi = _mm_set1_epi16(short(hi ^ 0x8000));
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i s = _mm_xor_si128(v, bias);
+        __m128i out = _mm_or_si128(_mm_cmplt_epi16(s, vlo), _mm_cmpgt_epi16(s, vhi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_andnot_si128(out, v));
+    }
+    GetScalarKernels()->depth_range_filter(src + i, dst + i, n - i, lo, hi);
+}
+
+const SimdKernels kSse2Kernels = {
+    DecodeDepth16Sse2,
+    ZigZagDelta16Sse2,
+    QuantizeDelta16Sse2,
+    DepthRangeFilterSse2,
+};
+
+}  // namespace
+
+const SimdKernels *mynteye::GetSse2Kernels() {
+    return &kSse2Kernels;
+}
+
+#else
+
+const SimdKernels *mynteye::GetSse2Kernels() {
+    return nullptr;
+}
+
+#endif  // MYNTEYE_SIMD_SSE2
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simd_p.h"
+
+using namespace std;
+using namespace mynteye;
+
+// Usage: simd_test
+//
+// Checks every kernel set this build has and the CPU supports against the
+// scalar reference, bit for bit, over sizes around the vector widths,
+// misaligned buffers, edge values and random data.
+//
+// The NEON set has not been run on ARM yet and dispatch leaves it off; a
+// pass of this test on ARM is what it takes to enable it. Without ARM
+// hardware, cross-compile and run under qemu-user:
+//
+//   aarch64-linux-gnu-g++ -O2 -static <include paths> -o simd_test
+//       simd_test.cc simd.cc simd_sse2.cc simd_neon.cc
+//   qemu-aarch64 ./simd_test
+//
+// arm-linux-gnueabihf-g++ with -mfpu=neon and qemu-arm cover 32-bit ARM.
+
+namespace {
+
+const size_t kSizes[] = { 0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 1003 };
+const int kRounds = 20;
+
+mt19937 rng(1);
+
+/** Edge values first, then random ones. */
+vector<uint16_t> Samples(size_t n, int round) {
+    static const uint16_t kEdges[] = { 0, 1, 0x7FFF, 0x8000, 0x8001, 0xFFFE, 0xFFFF };
+    vector<uint16_t> v(n);
+    for (size_t i = 0; i < n; i++) {
+        switch (round % 3) {
+        case 0: v[i] = kEdges[(i + round) % 7]; break;
+        case 1: v[i] = uint16_t(rng()); break;
+        default: v[i] = uint16_t(3000 + int(rng() % 64) - 32); break;
+        }
+    }
+    return v;
+}
+
+int failures = 0;
+
+template <typename T>
+void Expect(const vector<T> &want, const vector<T> &got, const string &what) {
+    if (memcmp(want.data(), got.data(), want.size() * sizeof(T)) == 0) return;
+    if (failures++ < 20) cout << "FAILED " << what << endl;
+}
+
+void Check(const SimdKernels &k, const string &name) {
+    const SimdKernels &ref = *GetScalarKernels();
+    const uint16_t kErrors[] = { 0, 1, 2, 5, 100, 0x7FFF, 0xFFFF };
+    for (size_t n : kSizes) {
+        for (int round = 0; round < kRounds; round++) {
+            string what = name + " n=" + to_string(n) + " round " + to_string(round);
+            // One past an aligned start, so loads are misaligned.
+            vector<uint16_t> src = Samples(n + 1, round);
+            vector<uint16_t> pred = Samples(n + 1, round + 1);
+            const uint16_t *s = src.data() + 1;
+            const uint16_t *p = pred.data() + 1;
+
+            vector<uint8_t> bytes(2 * n + 1);
+            for (auto &b : bytes) b = uint8_t(rng());
+            vector<uint16_t> want16(n), got16(n);
+            ref.decode_depth16(bytes.data() + 1, want16.data(), n);
+            k.decode_depth16(bytes.data() + 1, got16.data(), n);
+            Expect(want16, got16, what + " decode_depth16");
+
+            vector<uint32_t> want32(n), got32(n);
+            ref.zigzag_delta16(s, p[0], want32.data(), n);
+            k.zigzag_delta16(s, p[0], got32.data(), n);
+            Expect(want32, got32, what + " zigzag_delta16");
+
+            uint16_t e = kErrors[round % 7];
+            vector<uint16_t> want_recon(n), got_recon(n);
+            ref.quantize_delta16(s, p, e, want_recon.data(), want32.data(), n);
+            k.quantize_delta16(s, p, e, got_recon.data(), got32.data(), n);
+            Expect(want_recon, got_recon, what + " quantize_delta16 recon e=" + to_string(e));
+            Expect(want32, got32, what + " quantize_delta16 res e=" + to_string(e));
+
+            // Also lo > hi, which must filter everything out.
+            uint16_t lo = round % 4 == 3 ? 0xFFFF : uint16_t(rng());
+            uint16_t hi = round % 4 == 2 ? 0xFFFF : uint16_t(rng());
+            ref.depth_range_filter(s, want16.data(), n, lo, hi);
+            k.depth_range_filter(s, got16.data(), n, lo, hi);
+            Expect(want16, got16, what + " depth_range_filter " + to_string(lo) + "-" + to_string(hi));
+        }
+    }
+
+    // Every residual quantize_delta16 can see, for the errors above.
+    vector<uint16_t> src(0x10000), pred(0x10000, 0x8000);
+    for (size_t i = 0; i < src.size(); i++) src[i] = uint16_t(i);
+    for (uint16_t e : kErrors) {
+        vector<uint16_t> want_recon(src.size()), got_recon(src.size());
+        vector<uint32_t> want_res(src.size()), got_res(src.size());
+        for (uint16_t base : { uint16_t(0), uint16_t(0x8000), uint16_t(0xFFFF) }) {
+            fill(pred.begin(), pred.end(), base);
+            ref.quantize_delta16(src.data(), pred.data(), e, want_recon.data(), want_res.data(), src.size());
+            k.quantize_delta16(src.data(), pred.data(), e, got_recon.data(), got_res.data(), src.size());
+            string what = name + " quantize_delta16 all residuals e=" + to_string(e) +
+                " pred=" + to_string(base);
+            Expect(want_recon, got_recon, what);
+            Expect(want_res, got_res, what);
+        }
+    }
+}
+
+}  // namespace
+
+int main(int argc, char const *argv[]) {
+    struct Level {
+        SimdLevel level;
+        const SimdKernels *kernels;
+    };
+    const Level levels[] = {
+        { SimdLevel::SSE2, GetSse2Kernels() },
+        { SimdLevel::NEON, GetNeonKernels() },
+    };
+    int checked = 0;
+    for (const Level &l : levels) {
+        const char *name = GetSimdLevelName(l.level);
+        if (!l.kernels || !SetSimdLevel(l.level)) {
+            cout << name << ": not available" << endl;
+            continue;
+        }
+        int before = failures;
+        Check(*l.kernels, name);
+        cout << name << ": " << (failures == before ? "ok" : "FAILED") << endl;
+        checked++;
+    }
+    if (!checked) cout << "No SIMD kernels, only the scalar reference is built" << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_API_STARTUP_TIMINGS_H_
+#define MYNTEYE_API_STARTUP_TIMINGS_H_
+#pragma once
+
+#include "mynteye.h"
+
+namespace mynteye {
+
+/** Where the time of the last GetDevices and Open went, in milliseconds. */
+struct MYNTEYE_API StartupTimings {
+    double get_devices = 0;
+    double get_resolutions = 0;
+    double depth_data_type = 0;
+    double auto_exposure = 0;
+    double auto_white_balance = 0;
+    double registers = 0;
+    double open_device = 0;
+    /** Total of Open, get_devices excluded. */
+    double open_total = 0;
+};
+
+}  // namespace mynteye
+
+#endif  // MYNTEYE_API_STARTUP_TIMINGS_H_